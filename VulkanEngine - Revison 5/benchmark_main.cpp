@@ -0,0 +1,64 @@
+#include "headless_benchmark.hpp"
+
+//std
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// Usage: benchmark [--frames N] [--warmup N] [--width W] [--height H] [--grid N]
+//                  [--no-indirect] [--parallel] [--static-cache] [--quantized] [--csv FILE]
+// Runs without a window, so it also works on a display-less machine with a software ICD, e.g.
+//   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./benchmark --frames 300
+// The benchmark build leaves validation off; the loader can still enable it for a run:
+//   VK_INSTANCE_LAYERS=VK_LAYER_KHRONOS_validation ./benchmark --parallel --frames 60
+int main(int argc, char *argv[])
+{
+    lve::BenchmarkConfig config{};
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+
+            if (arg == "--frames" && hasValue) {
+                config.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--warmup" && hasValue) {
+                config.warmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--width" && hasValue) {
+                config.extent.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--height" && hasValue) {
+                config.extent.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--grid" && hasValue) {
+                config.gridSize = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--csv" && hasValue) {
+                config.csvPath = argv[++i];
+            } else if (arg == "--no-indirect") {
+                config.useIndirectDraw = false;
+            } else if (arg == "--parallel") {
+                config.useParallelRecording = true;
+            } else if (arg == "--static-cache") {
+                config.useStaticCommandCache = true;
+            } else if (arg == "--quantized") {
+                config.vertexFormat = lve::LveModel::VertexFormat::QUANTIZED;
+            } else {
+                std::cerr << "Unknown or incomplete argument: " << arg << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (config.extent.width == 0 || config.extent.height == 0 || config.gridSize == 0) {
+            std::cerr << "Width, height and grid size must be non-zero" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        lve::HeadlessBenchmark benchmark{config};
+        benchmark.run();
+    } catch(const std::exception& e)
+    {
+        std::cerr << "Exception caught: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -12,7 +12,7 @@ C:\VulkanSDK\1.4.321.1\Bin\glslc.exe shaders\simpleShader.frag -o shaders\simple
 
 REM Build the application
 echo Building C++ application...
-g++ -fdiagnostics-color=always -g -DDEBUG main.cpp ve_window.cpp ve_pipeline.cpp ve_device.cpp ve_swap_chain.cpp ve_model.cpp ve_transform.cpp ve_game_object.cpp ve_camera.cpp keyboard_movement_controller.cpp simple_game.cpp geometry_builder.cpp -o main.exe -I "C:\VulkanSDK\1.4.321.1\Include" -I "C:\glfw-3.4.bin.WIN64\include" -I "C:\glew-2.1.0\include" -I "C:\msys64\ucrt64\include" -I "." -L "C:\VulkanSDK\1.4.321.1\Lib" -lvulkan-1 -L "C:\glew-2.1.0\lib\Release\x64" -L "C:\glfw-3.4.bin.WIN64\lib-mingw-w64" -lglfw3dll -lglew32 -lopengl32
+g++ -fdiagnostics-color=always -g -DDEBUG main.cpp ve_window.cpp ve_pipeline.cpp ve_device.cpp ve_swap_chain.cpp ve_model.cpp ve_buffer.cpp ve_descriptors.cpp ve_geometry_pool.cpp ve_render_queue.cpp ve_instance_batcher.cpp ve_frustum_culler.cpp ve_thread_pool.cpp ve_parallel_recorder.cpp ve_static_command_cache.cpp ve_frame_command_pools.cpp ve_offscreen_target.cpp ve_latency_tracker.cpp ve_frame_timeline.cpp ve_deletion_queue.cpp ve_pipeline_manager.cpp ve_shader_module_cache.cpp ve_gpu_profiler.cpp ve_cpu_profiler.cpp ve_memory_allocator.cpp ve_upload_manager.cpp ve_transform.cpp ve_game_object.cpp ve_camera.cpp keyboard_movement_controller.cpp simple_game.cpp geometry_builder.cpp -o main.exe -I "C:\VulkanSDK\1.4.321.1\Include" -I "C:\glfw-3.4.bin.WIN64\include" -I "C:\glew-2.1.0\include" -I "C:\msys64\ucrt64\include" -I "." -L "C:\VulkanSDK\1.4.321.1\Lib" -lvulkan-1 -L "C:\glew-2.1.0\lib\Release\x64" -L "C:\glfw-3.4.bin.WIN64\lib-mingw-w64" -lglfw3dll -lglew32 -lopengl32
 
 if %ERRORLEVEL% EQU 0 (
     echo Build successful! You can now run main.exe
@@ -7,7 +7,7 @@
 
 namespace lve {
 
-std::shared_ptr<LveModel> GeometryBuilder::createCube(LveDevice& device, float size) {
+std::shared_ptr<LveModel> GeometryBuilder::createCube(LveDevice& device, float size, LveGeometryPool* geometryPool) {
     float half = size * 0.5f;
     
     std::vector<LveModel::Vertex> vertices{
@@ -39,10 +39,10 @@ std::shared_ptr<LveModel> GeometryBuilder::createCube(LveDevice& device, float s
         4, 5, 1,  1, 0, 4
     };
 
-    return std::make_shared<LveModel>(device, vertices, indices);
+    return std::make_shared<LveModel>(device, vertices, indices, geometryPool);
 }
 
-std::shared_ptr<LveModel> GeometryBuilder::createSphere(LveDevice& device, float radius, int segments, int rings) {
+std::shared_ptr<LveModel> GeometryBuilder::createSphere(LveDevice& device, float radius, int segments, int rings, LveGeometryPool* geometryPool) {
     std::vector<LveModel::Vertex> vertices;
     std::vector<uint32_t> indices;
 
@@ -83,10 +83,10 @@ std::shared_ptr<LveModel> GeometryBuilder::createSphere(LveDevice& device, float
         }
     }
 
-    return std::make_shared<LveModel>(device, vertices, indices);
+    return std::make_shared<LveModel>(device, vertices, indices, geometryPool);
 }
 
-std::shared_ptr<LveModel> GeometryBuilder::createPlane(LveDevice& device, float width, float height) {
+std::shared_ptr<LveModel> GeometryBuilder::createPlane(LveDevice& device, float width, float height, LveGeometryPool* geometryPool) {
     float halfW = width * 0.5f;
     float halfH = height * 0.5f;
     
@@ -101,7 +101,7 @@ std::shared_ptr<LveModel> GeometryBuilder::createPlane(LveDevice& device, float
         0, 1, 2,  2, 3, 0
     };
 
-    return std::make_shared<LveModel>(device, vertices, indices);
+    return std::make_shared<LveModel>(device, vertices, indices, geometryPool);
 }
 
 glm::vec3 GeometryBuilder::generateColor(float u, float v) {
@@ -112,7 +112,7 @@ glm::vec3 GeometryBuilder::generateColor(float u, float v) {
     return {r, g, b};
 }
 
-std::shared_ptr<LveModel> GeometryBuilder::createRifle(LveDevice& device, float scale) {
+std::shared_ptr<LveModel> GeometryBuilder::createRifle(LveDevice& device, float scale, LveGeometryPool* geometryPool) {
     std::vector<LveModel::Vertex> vertices;
     std::vector<uint32_t> indices;
     
@@ -218,7 +218,7 @@ std::shared_ptr<LveModel> GeometryBuilder::createRifle(LveDevice& device, float
         indices.push_back(vertexOffset + idx);
     }
     
-    return std::make_shared<LveModel>(device, vertices, indices);
+    return std::make_shared<LveModel>(device, vertices, indices, geometryPool);
 }
 
 }  // namespace lve
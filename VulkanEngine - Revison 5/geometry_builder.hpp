@@ -2,25 +2,27 @@
 
 #include "ve_model.hpp"
 #include "ve_device.hpp"
+#include "ve_geometry_pool.hpp"
 
 #include <memory>
 #include <vector>
 
 namespace lve {
 
+// All builders take an optional geometry pool; when given, the mesh is packed into it
 class GeometryBuilder {
  public:
   // Create a cube mesh
-  static std::shared_ptr<LveModel> createCube(LveDevice& device, float size = 1.0f);
+  static std::shared_ptr<LveModel> createCube(LveDevice& device, float size = 1.0f, LveGeometryPool* geometryPool = nullptr);
   
   // Create a sphere mesh
-  static std::shared_ptr<LveModel> createSphere(LveDevice& device, float radius = 1.0f, int segments = 16, int rings = 12);
+  static std::shared_ptr<LveModel> createSphere(LveDevice& device, float radius = 1.0f, int segments = 16, int rings = 12, LveGeometryPool* geometryPool = nullptr);
   
   // Create a plane mesh
-  static std::shared_ptr<LveModel> createPlane(LveDevice& device, float width = 1.0f, float height = 1.0f);
+  static std::shared_ptr<LveModel> createPlane(LveDevice& device, float width = 1.0f, float height = 1.0f, LveGeometryPool* geometryPool = nullptr);
   
   // Create a realistic rifle/gun model
-  static std::shared_ptr<LveModel> createRifle(LveDevice& device, float scale = 1.0f);
+  static std::shared_ptr<LveModel> createRifle(LveDevice& device, float scale = 1.0f, LveGeometryPool* geometryPool = nullptr);
 
  private:
   static glm::vec3 generateColor(float u, float v);
@@ -0,0 +1,482 @@
+#include "headless_benchmark.hpp"
+#include "geometry_builder.hpp"
+#include "ve_frame_info.hpp"
+#include "ve_swap_chain.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+namespace lve {
+
+HeadlessBenchmark::HeadlessBenchmark(const BenchmarkConfig &config) : config{config} {
+  loadScene();
+  createGlobalDescriptors();
+  createPipelineLayout();
+  createPipeline();
+  createTimestampQueries();
+}
+
+HeadlessBenchmark::~HeadlessBenchmark() {
+  if (timestampQueryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(lveDevice.device(), timestampQueryPool, nullptr);
+  }
+  vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+}
+
+void HeadlessBenchmark::run() {
+  uint32_t totalFrames = config.warmupFrames + config.frameCount;
+  timings.assign(totalFrames, FrameTiming{});
+
+  std::cout << "Benchmark: " << config.frameCount << " frames (+" << config.warmupFrames
+            << " warm-up) at " << config.extent.width << "x" << config.extent.height << ", "
+            << sceneObjects.size() << " objects"
+            << (config.useParallelRecording ? ", parallel recording" : "")
+            << (config.useStaticCommandCache ? ", static command cache" : "") << std::endl;
+
+  auto frameStart = std::chrono::steady_clock::now();
+  for (uint32_t frame = 0; frame < totalFrames; frame++) {
+    int frameIndex = offscreenTarget.acquireFrame();
+    auto cpuStart = std::chrono::steady_clock::now();
+
+    // The slot's fence has signaled: its timestamps are ready and its pool can be recycled
+    collectGpuTime(frameIndex);
+    frameCommandPools.reset(frameIndex);
+
+    updateScene(frame);
+    recordCommandBuffer(frameIndex);
+    timings[frame].objectsTested = frustumCuller.getStats().tested;
+    timings[frame].objectsCulled = frustumCuller.getStats().culled;
+    VkCommandBuffer commandBuffer = frameCommandPools.getPrimaryCommandBuffer(frameIndex);
+    offscreenTarget.submitCommandBuffers(&commandBuffer);
+    pendingTimestampFrames[frameIndex] = frame;
+
+    auto cpuEnd = std::chrono::steady_clock::now();
+    timings[frame].cpuMs =
+        std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count();
+    if (frame > 0) {
+      timings[frame - 1].frameMs =
+          std::chrono::duration<double, std::milli>(cpuStart - frameStart).count();
+    }
+    frameStart = cpuStart;
+  }
+
+  vkDeviceWaitIdle(lveDevice.device());
+  auto end = std::chrono::steady_clock::now();
+  timings.back().frameMs = std::chrono::duration<double, std::milli>(end - frameStart).count();
+  for (int i = 0; i < LveSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+    collectGpuTime(i);
+  }
+
+  report();
+  if (!config.csvPath.empty()) {
+    writeCsv();
+  }
+}
+
+void HeadlessBenchmark::loadScene() {
+  geometryPool = std::make_unique<LveGeometryPool>(
+      lveDevice,
+      LveGeometryPool::DEFAULT_VERTEX_CAPACITY,
+      LveGeometryPool::DEFAULT_INDEX_CAPACITY,
+      config.vertexFormat);
+  auto cubeModel = GeometryBuilder::createCube(lveDevice, 1.0f, geometryPool.get());
+  auto sphereModel = GeometryBuilder::createSphere(lveDevice, 0.5f, 16, 12, geometryPool.get());
+  auto floorModel = GeometryBuilder::createPlane(lveDevice, 1.0f, 1.0f, geometryPool.get());
+
+  float spacing = 1.5f;
+  float halfExtent = 0.5f * spacing * static_cast<float>(config.gridSize - 1);
+  for (uint32_t x = 0; x < config.gridSize; x++) {
+    for (uint32_t z = 0; z < config.gridSize; z++) {
+      auto object = LveGameObject::createGameObject();
+      object.model = (x + z) % 2 == 0 ? cubeModel : sphereModel;
+      object.transform.translation = {
+          static_cast<float>(x) * spacing - halfExtent,
+          0.0f,
+          static_cast<float>(z) * spacing - halfExtent};
+      object.transform.scale = {0.5f, 0.5f, 0.5f};
+      object.color = {
+          static_cast<float>(x) / static_cast<float>(config.gridSize),
+          0.5f,
+          static_cast<float>(z) / static_cast<float>(config.gridSize)};
+      sceneObjects.emplace(object.getId(), std::move(object));
+    }
+  }
+
+  auto floor = LveGameObject::createGameObject();
+  floor.model = floorModel;
+  floor.transform.translation = {0.0f, 0.5f, 0.0f};
+  floor.transform.scale = {2.0f * halfExtent + 4.0f, 1.0f, 2.0f * halfExtent + 4.0f};
+  floor.transform.rotation = {glm::radians(90.0f), 0.0f, 0.0f};
+  floor.color = {0.3f, 0.5f, 0.3f};
+  sceneObjects.emplace(floor.getId(), std::move(floor));
+
+  // Map nodes never move, so the pointers stay valid
+  uint32_t index = 0;
+  for (auto &kv : sceneObjects) {
+    (index++ % 8 == 0 ? spinningObjects : staticObjects).push_back(&kv.second);
+  }
+}
+
+void HeadlessBenchmark::createGlobalDescriptors() {
+  globalUboBuffer = std::make_unique<LveBuffer>(
+      lveDevice,
+      sizeof(GlobalUbo),
+      LveSwapChain::MAX_FRAMES_IN_FLIGHT,
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      lveDevice.properties.limits.minUniformBufferOffsetAlignment);
+  if (globalUboBuffer->map() != VK_SUCCESS) {
+    throw std::runtime_error("failed to map global uniform buffer!");
+  }
+
+  globalPool = LveDescriptorPool::Builder(lveDevice)
+                   .setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+                   .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+                   .build();
+
+  globalSetLayout = LveDescriptorSetLayout::Builder(lveDevice)
+                        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+                        .build();
+
+  globalDescriptorSets.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  for (int i = 0; i < LveSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+    auto bufferInfo = globalUboBuffer->descriptorInfoForIndex(i);
+    if (!LveDescriptorWriter(*globalSetLayout, *globalPool)
+             .writeBuffer(0, &bufferInfo)
+             .build(globalDescriptorSets[i])) {
+      throw std::runtime_error("failed to allocate global descriptor set!");
+    }
+  }
+}
+
+void HeadlessBenchmark::createPipelineLayout() {
+  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout->getDescriptorSetLayout()};
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+  pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = 0;
+  pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+  if (vkCreatePipelineLayout(lveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+}
+
+void HeadlessBenchmark::createPipeline() {
+  PipelineConfigInfo pipelineConfig{};
+  vePipeline::defaultPipelineConfigInfo(pipelineConfig);
+  pipelineConfig.renderPass = offscreenTarget.getRenderPass();
+  pipelineConfig.pipelineLayout = pipelineLayout;
+  pipelineConfig.vertexFormat = config.vertexFormat;
+  lvePipeline = std::make_unique<vePipeline>(
+      lveDevice,
+      "shaders/simpleShader.vert.spv",
+      "shaders/simpleShader.frag.spv",
+      pipelineConfig);
+}
+
+void HeadlessBenchmark::createTimestampQueries() {
+  pendingTimestampFrames.assign(LveSwapChain::MAX_FRAMES_IN_FLIGHT, -1);
+  uint32_t validBits = lveDevice.graphicsTimestampValidBits();
+  if (validBits == 0) {
+    std::cout << "Timestamps not supported; GPU times will not be reported" << std::endl;
+    return;
+  }
+  timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  VkQueryPoolCreateInfo queryPoolInfo{};
+  queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryPoolInfo.queryCount = 2 * LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+
+  if (vkCreateQueryPool(lveDevice.device(), &queryPoolInfo, nullptr, &timestampQueryPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create timestamp query pool!");
+  }
+}
+
+void HeadlessBenchmark::updateScene(uint32_t frame) {
+  // One full orbit over the measured frames, looking at the middle of the grid from above
+  // (negative y is up)
+  float progress = static_cast<float>(frame) / static_cast<float>(std::max(config.frameCount, 1u));
+  float angle = glm::two_pi<float>() * progress;
+  float radius = 0.75f * 1.5f * static_cast<float>(config.gridSize) + 2.0f;
+  cameraPosition = {radius * glm::sin(angle), -0.25f * radius, radius * glm::cos(angle)};
+
+  camera.setPerspectiveProjection(
+      glm::radians(50.0f),
+      offscreenTarget.extentAspectRatio(),
+      NEAR_PLANE,
+      FAR_PLANE);
+  camera.setViewTarget(cameraPosition, glm::vec3{0.0f});
+
+  // Some objects spin so each frame also has some instance data to upload
+  for (auto *object : spinningObjects) {
+    object->transform.rotation.y = angle * 4.0f;
+  }
+}
+
+void HeadlessBenchmark::recordCommandBuffer(int frameIndex) {
+  VkCommandBuffer commandBuffer = frameCommandPools.getPrimaryCommandBuffer(frameIndex);
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording command buffer!");
+  }
+
+  uint32_t firstQuery = 2 * static_cast<uint32_t>(frameIndex);
+  if (timestampQueryPool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(commandBuffer, timestampQueryPool, firstQuery, 2);
+    vkCmdWriteTimestamp(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        timestampQueryPool,
+        firstQuery);
+  }
+
+  GlobalUbo ubo{};
+  ubo.projection = camera.getProjection();
+  ubo.view = camera.getView();
+  ubo.projectionView = ubo.projection * ubo.view;
+  globalUboBuffer->writeToIndex(&ubo, frameIndex);
+
+  instanceBatcher.begin();
+  frustumCuller.begin(camera.getFrustumPlanes());
+  cullCandidates.clear();
+  // With the static cache the still objects are replayed from the cached recording instead
+  for (auto *object : spinningObjects) {
+    cullCandidates.push_back(object);
+  }
+  if (!config.useStaticCommandCache) {
+    cullCandidates.insert(cullCandidates.end(), staticObjects.begin(), staticObjects.end());
+  }
+  for (auto *object : cullCandidates) {
+    frustumCuller.add(*object->model, object->transform.mat4());
+  }
+  frustumCuller.cull();
+  for (uint32_t index : frustumCuller.getVisible()) {
+    instanceBatcher.add(*cullCandidates[index], lvePipeline.get());
+  }
+  instanceBatcher.upload(frameIndex);
+
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = offscreenTarget.getRenderPass();
+  renderPassInfo.framebuffer = offscreenTarget.getFrameBuffer(frameIndex);
+
+  renderPassInfo.renderArea.offset = {0, 0};
+  renderPassInfo.renderArea.extent = offscreenTarget.getExtent();
+
+  std::array<VkClearValue, 2> clearValues{};
+  clearValues[0].color = {0.1f, 0.1f, 0.1f, 1.0f};
+  clearValues[1].depthStencil = {1.0f, 0};
+  renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+  renderPassInfo.pClearValues = clearValues.data();
+
+  if (config.useParallelRecording || config.useStaticCommandCache) {
+    // Render pass contents are all-or-nothing, so with the static cache the per-frame objects are
+    // recorded into secondaries as well
+    vkCmdBeginRenderPass(
+        commandBuffer,
+        &renderPassInfo,
+        VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    if (config.useStaticCommandCache) {
+      VkCommandBuffer staticCommands = staticCommandCache.get(
+          frameIndex,
+          // Nothing static is ever added or moved; only compaction would invalidate the recording
+          geometryPool->getGeneration(),
+          renderPassInfo.renderPass,
+          [this](VkCommandBuffer secondaryCommandBuffer, int frameIndex) {
+            recordStaticScene(secondaryCommandBuffer, frameIndex);
+          });
+      vkCmdExecuteCommands(commandBuffer, 1, &staticCommands);
+    }
+    parallelRecorder.record(
+        commandBuffer,
+        frameIndex,
+        renderPassInfo.renderPass,
+        renderPassInfo.framebuffer,
+        static_cast<uint32_t>(instanceBatcher.getBatches().size()),
+        [this, frameIndex](VkCommandBuffer secondaryCommandBuffer, uint32_t first, uint32_t count) {
+          bindFrameState(secondaryCommandBuffer, frameIndex);
+          instanceBatcher.drawRange(secondaryCommandBuffer, frameIndex, first, count);
+        });
+  } else {
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    bindFrameState(commandBuffer, frameIndex);
+    if (config.useIndirectDraw) {
+      instanceBatcher.drawIndirect(commandBuffer, frameIndex, *geometryPool);
+    } else {
+      instanceBatcher.draw(commandBuffer, frameIndex);
+    }
+  }
+
+  vkCmdEndRenderPass(commandBuffer);
+
+  if (timestampQueryPool != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(
+        commandBuffer,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        timestampQueryPool,
+        firstQuery + 1);
+  }
+
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record command buffer!");
+  }
+}
+
+void HeadlessBenchmark::bindFrameState(VkCommandBuffer commandBuffer, int frameIndex) {
+  VkViewport viewport{};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = static_cast<float>(offscreenTarget.getExtent().width);
+  viewport.height = static_cast<float>(offscreenTarget.getExtent().height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  VkRect2D scissor{{0, 0}, offscreenTarget.getExtent()};
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+  vkCmdBindDescriptorSets(
+      commandBuffer,
+      VK_PIPELINE_BIND_POINT_GRAPHICS,
+      pipelineLayout,
+      0,
+      1,
+      &globalDescriptorSets[frameIndex],
+      0,
+      nullptr);
+}
+
+void HeadlessBenchmark::recordStaticScene(VkCommandBuffer commandBuffer, int frameIndex) {
+  // Only runs when frameIndex's recording is stale and its fence has been waited on, so the
+  // slot's instance and indirect buffers can be rewritten and then left alone
+  staticBatcher.begin();
+  for (auto *object : staticObjects) {
+    staticBatcher.add(*object, lvePipeline.get());
+  }
+  staticBatcher.upload(frameIndex);
+
+  bindFrameState(commandBuffer, frameIndex);
+  if (config.useIndirectDraw) {
+    staticBatcher.drawIndirect(commandBuffer, frameIndex, *geometryPool);
+  } else {
+    staticBatcher.draw(commandBuffer, frameIndex);
+  }
+}
+
+void HeadlessBenchmark::collectGpuTime(int frameIndex) {
+  int64_t frame = pendingTimestampFrames[frameIndex];
+  pendingTimestampFrames[frameIndex] = -1;
+  if (frame < 0 || timestampQueryPool == VK_NULL_HANDLE) return;
+
+  // Only called once the frame's fence has signaled, so the results are available without waiting
+  std::array<uint64_t, 2> ticks{};
+  if (vkGetQueryPoolResults(
+          lveDevice.device(),
+          timestampQueryPool,
+          2 * static_cast<uint32_t>(frameIndex),
+          2,
+          sizeof(ticks),
+          ticks.data(),
+          sizeof(uint64_t),
+          VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+    return;
+  }
+
+  // Masking the difference keeps it right when the counter wraps between the two writes
+  uint64_t elapsedTicks = (ticks[1] - ticks[0]) & timestampMask;
+  double nanoseconds =
+      static_cast<double>(elapsedTicks) * lveDevice.properties.limits.timestampPeriod;
+  timings[frame].gpuMs = nanoseconds / 1.0e6;
+}
+
+void HeadlessBenchmark::report() const {
+  if (config.frameCount == 0) return;
+
+  auto summarize = [this](const char *name, double FrameTiming::*field) {
+    std::vector<double> values;
+    values.reserve(config.frameCount);
+    for (size_t i = config.warmupFrames; i < timings.size(); i++) {
+      if (timings[i].*field >= 0.0) {
+        values.push_back(timings[i].*field);
+      }
+    }
+    if (values.empty()) {
+      std::cout << "  " << name << ": n/a" << std::endl;
+      return;
+    }
+
+    std::sort(values.begin(), values.end());
+    double total = 0.0;
+    for (double value : values) {
+      total += value;
+    }
+    auto percentile = [&values](double p) {
+      size_t index = static_cast<size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+      return values[index];
+    };
+
+    std::cout << "  " << std::left << std::setw(6) << name << std::right << std::fixed
+              << std::setprecision(3) << " avg " << total / static_cast<double>(values.size())
+              << " ms, min " << values.front() << ", p50 " << percentile(0.5) << ", p95 "
+              << percentile(0.95) << ", p99 " << percentile(0.99) << ", max " << values.back()
+              << std::endl;
+  };
+
+  std::cout << "Results over " << config.frameCount << " frames:" << std::endl;
+  summarize("cpu", &FrameTiming::cpuMs);
+  summarize("gpu", &FrameTiming::gpuMs);
+  summarize("frame", &FrameTiming::frameMs);
+
+  uint64_t tested = 0;
+  uint64_t culled = 0;
+  for (size_t i = config.warmupFrames; i < timings.size(); i++) {
+    tested += timings[i].objectsTested;
+    culled += timings[i].objectsCulled;
+  }
+  double frames = static_cast<double>(config.frameCount);
+  std::cout << "  culling: avg " << static_cast<double>(tested) / frames << " objects tested, "
+            << static_cast<double>(culled) / frames << " culled ("
+            << (tested > 0 ? 100.0 * static_cast<double>(culled) / static_cast<double>(tested)
+                           : 0.0)
+            << "%)" << std::endl;
+  if (config.useStaticCommandCache) {
+    std::cout << "  static command cache: " << staticBatcher.getBatches().size() << " batches, "
+              << staticCommandCache.getRecordCount() << " recordings" << std::endl;
+  }
+}
+
+void HeadlessBenchmark::writeCsv() const {
+  std::ofstream file{config.csvPath};
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to open file: " + config.csvPath);
+  }
+
+  file << "frame,cpu_ms,gpu_ms,frame_ms,objects_tested,objects_culled\n";
+  for (size_t i = config.warmupFrames; i < timings.size(); i++) {
+    file << i - config.warmupFrames << "," << timings[i].cpuMs << "," << timings[i].gpuMs << ","
+         << timings[i].frameMs << "," << timings[i].objectsTested << ","
+         << timings[i].objectsCulled << "\n";
+  }
+  std::cout << "Per-frame timings written to " << config.csvPath << std::endl;
+}
+
+}  // namespace lve
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "ve_buffer.hpp"
+#include "ve_camera.hpp"
+#include "ve_descriptors.hpp"
+#include "ve_device.hpp"
+#include "ve_frame_command_pools.hpp"
+#include "ve_frustum_culler.hpp"
+#include "ve_game_object.hpp"
+#include "ve_geometry_pool.hpp"
+#include "ve_instance_batcher.hpp"
+#include "ve_offscreen_target.hpp"
+#include "ve_parallel_recorder.hpp"
+#include "ve_pipeline.hpp"
+#include "ve_static_command_cache.hpp"
+#include "ve_thread_pool.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+struct BenchmarkConfig {
+  uint32_t frameCount = 600;
+  // Rendered before measuring starts so pipeline warm-up and first uploads are not counted
+  uint32_t warmupFrames = 60;
+  VkExtent2D extent{1280, 720};
+  // The scene is a gridSize x gridSize field of cubes and spheres on a floor plane
+  uint32_t gridSize = 32;
+  bool useIndirectDraw = true;
+  // Record the draw batches into secondary command buffers on worker threads, as SimpleGame does;
+  // like there, this path draws per batch rather than indirectly
+  bool useParallelRecording = false;
+  // Record the objects that never move once per frame slot and replay them every frame; only the
+  // spinning objects are culled, batched and recorded per frame
+  bool useStaticCommandCache = false;
+  // Vertex layout of every mesh in the scene
+  LveModel::VertexFormat vertexFormat = LveModel::VertexFormat::FLOAT32;
+  // Per-frame timings are written here as CSV when not empty
+  std::string csvPath;
+};
+
+// Renders the scene offscreen (no window, surface or swap chain) along a scripted camera orbit for
+// a fixed number of frames and reports CPU and GPU time per frame. The camera path and scene are
+// deterministic, so runs are comparable across builds and machines, including software ICDs
+// such as lavapipe on a machine without a display.
+class HeadlessBenchmark {
+ public:
+  static constexpr float NEAR_PLANE = 0.1f;
+  static constexpr float FAR_PLANE = 100.0f;
+
+  HeadlessBenchmark(const BenchmarkConfig &config);
+  ~HeadlessBenchmark();
+
+  HeadlessBenchmark(const HeadlessBenchmark &) = delete;
+  HeadlessBenchmark &operator=(const HeadlessBenchmark &) = delete;
+
+  void run();
+
+ private:
+  struct FrameTiming {
+    // Culling, batching, recording and submission, excluding the wait for a free frame slot
+    double cpuMs = 0.0;
+    // Wall time from the start of this frame to the start of the next
+    double frameMs = 0.0;
+    // Top to bottom of pipe on the GPU; negative when timestamps are unsupported
+    double gpuMs = -1.0;
+    // Frustum culler counters; objects replayed from the static command cache are not tested
+    uint32_t objectsTested = 0;
+    uint32_t objectsCulled = 0;
+  };
+
+  void loadScene();
+  void createGlobalDescriptors();
+  void createPipelineLayout();
+  void createPipeline();
+  void createTimestampQueries();
+  void updateScene(uint32_t frame);
+  void recordCommandBuffer(int frameIndex);
+  // Viewport, scissor and the global descriptor set, which secondaries don't inherit
+  void bindFrameState(VkCommandBuffer commandBuffer, int frameIndex);
+  void recordStaticScene(VkCommandBuffer commandBuffer, int frameIndex);
+  void collectGpuTime(int frameIndex);
+  void report() const;
+  void writeCsv() const;
+
+  BenchmarkConfig config;
+
+  LveDevice lveDevice{};
+  LveOffscreenTarget offscreenTarget{lveDevice, config.extent};
+  std::unique_ptr<vePipeline> lvePipeline;
+  VkPipelineLayout pipelineLayout;
+  LveFrameCommandPools frameCommandPools{lveDevice};
+  LveThreadPool threadPool{};
+  LveParallelRecorder parallelRecorder{lveDevice, threadPool};
+  LveInstanceBatcher staticBatcher{lveDevice};
+  LveStaticCommandCache staticCommandCache{lveDevice};
+  LveInstanceBatcher instanceBatcher{lveDevice};
+  LveFrustumCuller frustumCuller{};
+  std::vector<LveGameObject *> cullCandidates;
+
+  std::unique_ptr<LveDescriptorPool> globalPool;
+  std::unique_ptr<LveDescriptorSetLayout> globalSetLayout;
+  std::unique_ptr<LveBuffer> globalUboBuffer;
+  std::vector<VkDescriptorSet> globalDescriptorSets;
+
+  // Two timestamps per frame slot, read back once the slot's fence has been waited on
+  VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+  // Ticks are only meaningful in the low timestampValidBits bits
+  uint64_t timestampMask = 0;
+  // Frame number whose timestamps each slot currently holds, or -1
+  std::vector<int64_t> pendingTimestampFrames;
+
+  // Declared before the scene objects so it outlives the models that live in it
+  std::unique_ptr<LveGeometryPool> geometryPool;
+  LveGameObject::Map sceneObjects;
+  // Every eighth object spins; the rest never move after loadScene()
+  std::vector<LveGameObject *> spinningObjects;
+  std::vector<LveGameObject *> staticObjects;
+  LveCamera camera{};
+  glm::vec3 cameraPosition{0.0f};
+
+  std::vector<FrameTiming> timings;
+};
+
+}  // namespace lve
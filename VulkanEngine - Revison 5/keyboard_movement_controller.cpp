@@ -7,6 +7,8 @@
 namespace lve {
 
 void KeyboardMovementController::moveInPlaneXZ(GLFWwindow* window, float dt, LveGameObject& gameObject) {
+    lastInputTime = std::chrono::steady_clock::now();
+
     // Handle escape key to exit game
     if (glfwGetKey(window, keys.exitGame) == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, GLFW_TRUE);
@@ -6,6 +6,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <chrono>
+
 namespace lve {
 
 class KeyboardMovementController {
@@ -32,6 +34,9 @@ class KeyboardMovementController {
   bool shouldShoot(GLFWwindow* window);
   glm::vec3 getShootDirection(const LveGameObject& gameObject);
 
+  // When moveInPlaneXZ last read the keyboard and mouse, for input-to-present latency measurement
+  std::chrono::steady_clock::time_point getLastInputTime() const { return lastInputTime; }
+
   KeyMappings keys{};
   float moveSpeed{3.0f};
   float lookSpeed{1.5f};
@@ -54,6 +59,7 @@ class KeyboardMovementController {
   double lastMouseX{0.0};
   double lastMouseY{0.0};
   bool firstMouse{true};
+  std::chrono::steady_clock::time_point lastInputTime{};
   
   // Physics state
   float verticalVelocity{0.0f};
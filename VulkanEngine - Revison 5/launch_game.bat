@@ -5,6 +5,13 @@ echo Launching Vulkan FPS Game...
 REM Add MSYS2 runtime to PATH
 set PATH=C:\msys64\ucrt64\bin;%PATH%
 
+REM The compiled shaders are not tracked; build.bat or compile.bat generates them
+if not exist shaders\simpleShader.vert.spv (
+    echo Compiled shaders not found. Run build.bat first.
+    pause
+    exit /b 1
+)
+
 REM Launch the game
 main.exe
 
@@ -1,13 +1,21 @@
 #version 450
 
-layout(push_constant) uniform Push {
-  mat4 transform;
-  vec3 color;
-} push;
-
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragWorldPosition;
 layout(location = 0) out vec4 outColor;
 
+// Flat directional lighting from screen-space derivatives, since vertices carry no normals
+layout(constant_id = 1) const bool USE_LIGHTING = false;
+
+const vec3 LIGHT_DIRECTION = vec3(0.577, -0.577, -0.577);
+const float AMBIENT = 0.3;
+
 void main() {
-  outColor = vec4(push.color, 1.0);
+  vec3 color = fragColor;
+  if (USE_LIGHTING) {
+    vec3 normal = normalize(cross(dFdx(fragWorldPosition), dFdy(fragWorldPosition)));
+    float diffuse = abs(dot(normal, LIGHT_DIRECTION));
+    color *= AMBIENT + (1.0 - AMBIENT) * diffuse;
+  }
+  outColor = vec4(color, 1.0);
 }
\ No newline at end of file
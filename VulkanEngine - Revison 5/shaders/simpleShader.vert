@@ -1,16 +1,31 @@
 #version 450
 
+// Floats for LveModel::VertexFormat::FLOAT32 meshes. QUANTIZED meshes store normalized integers,
+// which the vertex fetch already converts to [0, 1]: position is then relative to the mesh's
+// bounding box, and instanceModel includes the dequantization, so both layouts share this code.
 layout(location = 0) in vec3 position;  // Changed from vec2 to vec3
 layout(location = 1) in vec3 color;
 
-layout(push_constant) uniform Push {
-  mat4 transform;
-  vec3 color;
-} push;
+// Per-instance attributes (LveModel::InstanceData), binding 1
+layout(location = 2) in mat4 instanceModel;  // occupies locations 2-5
+layout(location = 6) in vec4 instanceColor;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+  mat4 projection;
+  mat4 view;
+  mat4 projectionView;
+} ubo;
+
+// Specialization constants (vePipeline::setSpecializationConstant); each variant is compiled with
+// the branch already resolved
+layout(constant_id = 0) const bool USE_VERTEX_COLOR = false;  // tint by the per-vertex color
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragWorldPosition;
 
 void main() {
-  gl_Position = push.transform * vec4(position, 1.0);  // Use 1.0 for w component
-  fragColor = color;
+  vec4 worldPosition = instanceModel * vec4(position, 1.0);  // Use 1.0 for w component
+  gl_Position = ubo.projectionView * worldPosition;
+  fragWorldPosition = worldPosition.xyz;
+  fragColor = USE_VERTEX_COLOR ? instanceColor.rgb * color : instanceColor.rgb;
 }
\ No newline at end of file
@@ -1,7 +1,10 @@
 #include "simple_game.hpp"
 #include "geometry_builder.hpp"
+#include "ve_cpu_profiler.hpp"
+#include "ve_frame_info.hpp"
 
 #include <stdexcept>
+#include <algorithm>
 #include <cassert>
 #include <array>
 #include <chrono>
@@ -14,17 +17,16 @@
 
 namespace lve {
 
-struct SimplePushConstantData {
-  glm::mat4 transform{1.0f};
-  glm::vec3 color;
-};
-
 SimpleGame::SimpleGame() {
   currentTime = std::chrono::steady_clock::now();
   loadGameObjects();
+  createGlobalDescriptors();
   createPipelineLayout();
+  if (lveDevice.supportsTimelineSemaphores()) {
+    frameTimeline = std::make_unique<LveFrameTimeline>(lveDevice);
+    swapChainConfig.frameTimeline = frameTimeline.get();
+  }
   recreateSwapChain();
-  createCommandBuffers();
   
   // Set up initial FPS camera position
   viewerObject.transform.translation = {0.0f, -1.5f, -3.0f}; // Start above the ground
@@ -39,6 +41,8 @@ SimpleGame::SimpleGame() {
 }
 
 SimpleGame::~SimpleGame() { 
+  // Compiles still running use the layout
+  pipelineManager.waitIdle();
   vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr); 
 }
 
@@ -51,8 +55,10 @@ void SimpleGame::run() {
   std::cout << " Press ENTER to start the game         " << std::endl;
   std::cout << " Press ESC to exit                     " << std::endl;
   std::cout << "========================================" << std::endl;
+  LVE_PROFILE_THREAD_NAME("main");
   
   while (!lveWindow.shouldClose()) {
+    LVE_PROFILE_FRAME();
     glfwPollEvents();
 
     auto newTime = std::chrono::steady_clock::now();
@@ -65,55 +71,65 @@ void SimpleGame::run() {
 
     // Always set up camera projection for rendering
     float aspect = lveSwapChain->extentAspectRatio();
-    camera.setPerspectiveProjection(glm::radians(50.0f), aspect, 0.1f, 10.0f);
+    camera.setPerspectiveProjection(glm::radians(50.0f), aspect, NEAR_PLANE, FAR_PLANE);
     camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
 
     // Handle input based on game state
-    switch (gameState) {
-      case GameState::MENU:
-        handleMenuInput();
-        updateMenuVisuals(); // Update visual menu appearance
-        displayMenu();
-        break;
+    {
+      LVE_PROFILE_ZONE("update");
+      switch (gameState) {
+        case GameState::MENU:
+          handleMenuInput();
+          updateMenuVisuals(); // Update visual menu appearance
+          displayMenu();
+          break;
         
-      case GameState::PLAYING:
-        handleGameInput(frameTime);
-        break;
+        case GameState::PLAYING:
+          handleGameInput(frameTime);
+          break;
         
-      case GameState::PAUSED:
-        handleMenuInput(); // Reuse menu input for pause menu
-        displayPauseMenu();
-        break;
+        case GameState::PAUSED:
+          handleMenuInput(); // Reuse menu input for pause menu
+          displayPauseMenu();
+          break;
+      }
     }
 
     // Always draw the frame
     drawFrame();
+    reportRenderStats(frameTime);
   }
 
   vkDeviceWaitIdle(lveDevice.device());
+  LVE_PROFILE_WRITE_TRACE("cpu_trace.json");
 }
 
 void SimpleGame::loadGameObjects() {
   std::cout << "Loading game objects..." << std::endl;
+  geometryPool = std::make_unique<LveGeometryPool>(
+      lveDevice,
+      LveGeometryPool::DEFAULT_VERTEX_CAPACITY,
+      LveGeometryPool::DEFAULT_INDEX_CAPACITY,
+      sceneVertexFormat);
   
   // Create projectile model for shooting (smaller)
   std::cout << "Creating projectile model..." << std::endl;
-  projectileModel = GeometryBuilder::createSphere(lveDevice, 6); // Smaller sphere
+  projectileModel = GeometryBuilder::createSphere(lveDevice, 6, 16, 12, geometryPool.get()); // Smaller sphere
   std::cout << "Projectile model created!" << std::endl;
   
   // Create weapon model
   std::cout << "Creating weapon model..." << std::endl;
-  weaponModel = GeometryBuilder::createCube(lveDevice, 0.5f); // Back to cube for testing
+  weaponModel = GeometryBuilder::createCube(lveDevice, 0.5f, geometryPool.get()); // Back to cube for testing
   std::cout << "Weapon model created!" << std::endl;
   
   // Create menu cube model for visual menu
   std::cout << "Creating menu cube model..." << std::endl;
-  menuCubeModel = GeometryBuilder::createCube(lveDevice);
+  menuCubeModel = GeometryBuilder::createCube(lveDevice, 1.0f, geometryPool.get());
   std::cout << "Menu cube model created!" << std::endl;
   
   // Create multiple cubes for a more interesting environment
   std::cout << "Creating cube model..." << std::endl;
-  auto cubeModel = GeometryBuilder::createCube(lveDevice);
+  auto cubeModel = GeometryBuilder::createCube(lveDevice, 1.0f, geometryPool.get());
   std::cout << "Cube model created successfully!" << std::endl;
   
   // Main open platform (with a hole in the middle)
@@ -190,7 +206,7 @@ void SimpleGame::loadGameObjects() {
   
   std::cout << "Creating floor plane..." << std::endl;
   // Ground plane
-  auto floorModel = GeometryBuilder::createPlane(lveDevice);
+  auto floorModel = GeometryBuilder::createPlane(lveDevice, 1.0f, 1.0f, geometryPool.get());
   auto floor = LveGameObject::createGameObject();
   floor.model = floorModel;
   floor.transform.translation = {0.0f, 3.0f, 0.0f};
@@ -202,21 +218,53 @@ void SimpleGame::loadGameObjects() {
   // Create visual menu objects
   createMenuObjects();
   
+  // The static scenery is complete; any cached recording of it is now out of date
+  staticSceneGeneration++;
+  
   std::cout << "All game objects loaded successfully! Total objects: " << gameObjects.size() << std::endl;
 }
 
+void SimpleGame::createGlobalDescriptors() {
+  globalUboBuffer = std::make_unique<LveBuffer>(
+      lveDevice,
+      sizeof(GlobalUbo),
+      LveSwapChain::MAX_FRAMES_IN_FLIGHT,
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      lveDevice.properties.limits.minUniformBufferOffsetAlignment);
+  if (globalUboBuffer->map() != VK_SUCCESS) {
+    throw std::runtime_error("failed to map global uniform buffer!");
+  }
+
+  globalPool = LveDescriptorPool::Builder(lveDevice)
+                   .setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+                   .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+                   .build();
+
+  globalSetLayout = LveDescriptorSetLayout::Builder(lveDevice)
+                        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+                        .build();
+
+  globalDescriptorSets.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  for (int i = 0; i < LveSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+    auto bufferInfo = globalUboBuffer->descriptorInfoForIndex(i);
+    if (!LveDescriptorWriter(*globalSetLayout, *globalPool)
+             .writeBuffer(0, &bufferInfo)
+             .build(globalDescriptorSets[i])) {
+      throw std::runtime_error("failed to allocate global descriptor set!");
+    }
+  }
+}
+
 void SimpleGame::createPipelineLayout() {
-  VkPushConstantRange pushConstantRange{};
-  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-  pushConstantRange.offset = 0;
-  pushConstantRange.size = sizeof(SimplePushConstantData);
+  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout->getDescriptorSetLayout()};
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 0;
-  pipelineLayoutInfo.pSetLayouts = nullptr;
-  pipelineLayoutInfo.pushConstantRangeCount = 1;
-  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+  pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = 0;
+  pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
   if (vkCreatePipelineLayout(lveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
       VK_SUCCESS) {
@@ -228,15 +276,37 @@ void SimpleGame::createPipeline() {
   assert(lveSwapChain != nullptr && "Cannot create pipeline before swap chain");
   assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
+  // Every permutation was built for the previous render pass formats. Frames still in flight may
+  // be drawing with them, so release() retires them rather than destroying them.
+  for (auto handle : scenePipelinePermutations) {
+    pipelineManager.release(handle);
+  }
+  scenePipelinePermutations.clear();
+  lvePipeline = nullptr;
+  selectScenePipeline();
+}
+
+void SimpleGame::selectScenePipeline() {
   PipelineConfigInfo pipelineConfig{};
   vePipeline::defaultPipelineConfigInfo(pipelineConfig);
   pipelineConfig.renderPass = lveSwapChain->getRenderPass();
   pipelineConfig.pipelineLayout = pipelineLayout;
-  lvePipeline = std::make_unique<vePipeline>(
-      lveDevice,
+  pipelineConfig.vertexFormat = sceneVertexFormat;
+  vePipeline::setSpecializationConstant(pipelineConfig, SPEC_USE_VERTEX_COLOR, false);
+  vePipeline::setSpecializationConstant(pipelineConfig, SPEC_USE_LIGHTING, useLighting);
+
+  // Compiled in the background the first time each permutation is asked for. Until it is ready
+  // the frame keeps drawing with the current pipeline, or draws no scene at all if there is none.
+  scenePipelineHandle = pipelineManager.requestPermutation(
       "shaders/simpleShader.vert.spv",
       "shaders/simpleShader.frag.spv",
       pipelineConfig);
+  if (std::find(
+          scenePipelinePermutations.begin(),
+          scenePipelinePermutations.end(),
+          scenePipelineHandle) == scenePipelinePermutations.end()) {
+    scenePipelinePermutations.push_back(scenePipelineHandle);
+  }
 }
 
 void SimpleGame::recreateSwapChain() {
@@ -245,47 +315,46 @@ void SimpleGame::recreateSwapChain() {
     extent = lveWindow.getExtent();
     glfwWaitEvents();
   }
-  vkDeviceWaitIdle(lveDevice.device());
 
+  bool formatsChanged = true;
   if (lveSwapChain == nullptr) {
-    lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent);
+    lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent, swapChainConfig);
   } else {
-    lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent, std::move(lveSwapChain));
-
-    if (lveSwapChain->imageCount() != commandBuffers.size()) {
-      freeCommandBuffers();
-      createCommandBuffers();
+    // Queued compiles still name the old render pass, which the deletion queue destroys a few
+    // frames after the old swap chain is retired
+    if (pipelineManager.getPendingCount() > 0) {
+      pipelineManager.waitIdle();
     }
+    VkFormat previousImageFormat = lveSwapChain->getSwapChainImageFormat();
+    VkFormat previousDepthFormat = lveSwapChain->getSwapChainDepthFormat();
+    lveSwapChain = std::make_unique<LveSwapChain>(
+        lveDevice,
+        extent,
+        std::move(lveSwapChain),
+        swapChainConfig);
+    formatsChanged = !lveSwapChain->compareSwapFormats(previousImageFormat, previousDepthFormat);
   }
+  swapChainConfigChanged = false;
 
-  createPipeline();
-}
-
-void SimpleGame::createCommandBuffers() {
-  commandBuffers.resize(lveSwapChain->imageCount());
-
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool = lveDevice.getCommandPool();
-  allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
-
-  if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, commandBuffers.data()) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate command buffers!");
+  // Viewport and scissor are dynamic state, so a resize alone leaves the pipeline valid; only a
+  // render pass with different attachment formats needs it rebuilt
+  if (formatsChanged || scenePipelineHandle == LvePipelineManager::INVALID_HANDLE) {
+    createPipeline();
   }
+  staticCommandCache.invalidate();
 }
 
-void SimpleGame::freeCommandBuffers() {
-  vkFreeCommandBuffers(
-      lveDevice.device(),
-      lveDevice.getCommandPool(),
-      static_cast<uint32_t>(commandBuffers.size()),
-      commandBuffers.data());
-  commandBuffers.clear();
+void SimpleGame::setSwapChainConfig(const LveSwapChain::Config &config) {
+  swapChainConfig = config;
+  swapChainConfigChanged = true;
 }
 
 void SimpleGame::drawFrame() {
+  LVE_PROFILE_ZONE("drawFrame");
+  if (swapChainConfigChanged) {
+    recreateSwapChain();
+  }
+
   uint32_t imageIndex;
   auto result = lveSwapChain->acquireNextImage(&imageIndex);
 
@@ -298,8 +367,23 @@ void SimpleGame::drawFrame() {
     throw std::runtime_error("failed to acquire swap chain image!");
   }
 
+  // acquireNextImage has waited on this frame slot's fence, so its pool can be recycled
+  int frameIndex = lveSwapChain->getCurrentFrameIndex();
+  frameCommandPools.reset(frameIndex);
+
+  vePipeline *scenePipeline = pipelineManager.get(scenePipelineHandle, lvePipeline);
+  if (scenePipeline != lvePipeline) {
+    // The cached static scene was recorded with the previous pipeline, or without one
+    lvePipeline = scenePipeline;
+    staticCommandCache.invalidate();
+  }
+  latencyTracker.frameCompleted(frameIndex);
+  latencyTracker.frameStarted(frameIndex, cameraController.getLastInputTime());
+
   recordCommandBuffer(imageIndex);
-  result = lveSwapChain->submitCommandBuffers(&commandBuffers[imageIndex], &imageIndex);
+  VkCommandBuffer commandBuffer = frameCommandPools.getPrimaryCommandBuffer(frameIndex);
+  result = lveSwapChain->submitCommandBuffers(&commandBuffer, &imageIndex);
+  latencyTracker.framePresented(frameIndex);
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
       lveWindow.wasWindowResized()) {
     lveWindow.resetWindowResizedFlag();
@@ -313,12 +397,33 @@ void SimpleGame::drawFrame() {
 }
 
 void SimpleGame::recordCommandBuffer(int imageIndex) {
+  LVE_PROFILE_ZONE("recordCommandBuffer");
+  int frameIndex = lveSwapChain->getCurrentFrameIndex();
+  VkCommandBuffer commandBuffer = frameCommandPools.getPrimaryCommandBuffer(frameIndex);
+
   VkCommandBufferBeginInfo beginInfo{};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-  if (vkBeginCommandBuffer(commandBuffers[imageIndex], &beginInfo) != VK_SUCCESS) {
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
     throw std::runtime_error("failed to begin recording command buffer!");
   }
+  gpuProfiler.beginFrame(commandBuffer, frameIndex);
+
+  // One projection * view multiply per frame; the model matrix is applied per instance on the GPU.
+  // This frame slot's fence has already been waited on, so its UBO slot is free to overwrite.
+  GlobalUbo ubo{};
+  ubo.projection = camera.getProjection();
+  ubo.view = camera.getView();
+  ubo.projectionView = ubo.projection * ubo.view;
+  globalUboBuffer->writeToIndex(&ubo, frameIndex);
+
+  {
+    LVE_PROFILE_ZONE("collectInstances");
+    collectInstances();
+    instanceBatcher.upload(frameIndex);
+  }
+  LVE_PROFILE_COUNTER("batches", instanceBatcher.getBatches().size());
 
   VkRenderPassBeginInfo renderPassInfo{};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -334,8 +439,58 @@ void SimpleGame::recordCommandBuffer(int imageIndex) {
   renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
   renderPassInfo.pClearValues = clearValues.data();
 
-  vkCmdBeginRenderPass(commandBuffers[imageIndex], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  bool useSecondaries = useStaticCommandCache || useParallelRecording;
+  // The secondaries don't inherit queries, so only inline recording counts invocations
+  uint32_t sceneScope = gpuProfiler.beginScope(commandBuffer, "scene pass", !useSecondaries);
+  if (useSecondaries) {
+    // Workers record slices of the batch list into secondaries; the primary only executes them.
+    // With the static cache on, the cached scenery goes first and the workers only get dynamic
+    // objects (render pass contents are all-or-nothing, so the dynamic part is a secondary too).
+    vkCmdBeginRenderPass(
+        commandBuffer,
+        &renderPassInfo,
+        VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    if (useStaticCommandCache && gameState != GameState::MENU && lvePipeline != nullptr) {
+      VkCommandBuffer staticCommands = staticCommandCache.get(
+          frameIndex,
+          // Compaction moves pooled meshes, so it invalidates the recording as well
+          staticSceneGeneration + geometryPool->getGeneration(),
+          renderPassInfo.renderPass,
+          [this](VkCommandBuffer secondaryCommandBuffer, int frameIndex) {
+            recordStaticScene(secondaryCommandBuffer, frameIndex);
+          });
+      vkCmdExecuteCommands(commandBuffer, 1, &staticCommands);
+    }
+    parallelRecorder.record(
+        commandBuffer,
+        frameIndex,
+        renderPassInfo.renderPass,
+        renderPassInfo.framebuffer,
+        static_cast<uint32_t>(instanceBatcher.getBatches().size()),
+        [this, frameIndex](VkCommandBuffer secondaryCommandBuffer, uint32_t first, uint32_t count) {
+          bindFrameState(secondaryCommandBuffer, frameIndex);
+          instanceBatcher.drawRange(secondaryCommandBuffer, frameIndex, first, count);
+        });
+  } else {
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    bindFrameState(commandBuffer, frameIndex);
+    LveGpuProfiler::Scope batchScope{gpuProfiler, commandBuffer, "draw batches"};
+    if (useIndirectDraw) {
+      instanceBatcher.drawIndirect(commandBuffer, frameIndex, *geometryPool);
+    } else {
+      instanceBatcher.draw(commandBuffer, frameIndex);
+    }
+  }
+
+  vkCmdEndRenderPass(commandBuffer);
+  gpuProfiler.endScope(commandBuffer, sceneScope);
+  gpuProfiler.endFrame(commandBuffer);
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record command buffer!");
+  }
+}
 
+void SimpleGame::bindFrameState(VkCommandBuffer commandBuffer, int frameIndex) {
   VkViewport viewport{};
   viewport.x = 0.0f;
   viewport.y = 0.0f;
@@ -344,93 +499,131 @@ void SimpleGame::recordCommandBuffer(int imageIndex) {
   viewport.minDepth = 0.0f;
   viewport.maxDepth = 1.0f;
   VkRect2D scissor{{0, 0}, lveSwapChain->getSwapChainExtent()};
-  vkCmdSetViewport(commandBuffers[imageIndex], 0, 1, &viewport);
-  vkCmdSetScissor(commandBuffers[imageIndex], 0, 1, &scissor);
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  // The pipeline itself is bound by the instance batcher, once per run of batches that use it
+  vkCmdBindDescriptorSets(
+      commandBuffer,
+      VK_PIPELINE_BIND_POINT_GRAPHICS,
+      pipelineLayout,
+      0,
+      1,
+      &globalDescriptorSets[frameIndex],
+      0,
+      nullptr);
+}
 
-  lvePipeline->bind(commandBuffers[imageIndex]);
+void SimpleGame::recordStaticScene(VkCommandBuffer commandBuffer, int frameIndex) {
+  // Only runs when the recording is stale, and this frame slot's fence has been waited on, so the
+  // slot's instance and indirect buffers can be rewritten here and then left alone until next time
+  staticBatcher.begin();
+  staticBatcher.addAll(gameObjects, lvePipeline);
+  staticBatcher.upload(frameIndex);
+
+  bindFrameState(commandBuffer, frameIndex);
+  if (useIndirectDraw) {
+    staticBatcher.drawIndirect(commandBuffer, frameIndex, *geometryPool);
+  } else {
+    staticBatcher.draw(commandBuffer, frameIndex);
+  }
+}
+
+void SimpleGame::collectInstances() {
+  instanceBatcher.begin();
+  frustumCuller.begin(camera.getFrustumPlanes());
+  cullCandidates.clear();
+
+  // Nothing can be drawn until the scene pipeline has compiled
+  if (lvePipeline == nullptr) return;
 
   if (gameState == GameState::MENU) {
     // Render menu objects when in menu state
-    for (auto& kv : menuObjects) {
-      auto& obj = kv.second;
-      if (obj.model == nullptr) continue;
-
-      SimplePushConstantData push{};
-      push.transform = camera.getProjection() * camera.getView() * obj.transform.mat4();
-      push.color = obj.color;
-
-      vkCmdPushConstants(
-        commandBuffers[imageIndex],
-        pipelineLayout,
-        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-        0,
-        sizeof(SimplePushConstantData),
-        &push);
-      obj.model->bind(commandBuffers[imageIndex]);
-      obj.model->draw(commandBuffers[imageIndex]);
-    }
+    addCullCandidates(menuObjects);
   } else if (gameState == GameState::PLAYING || gameState == GameState::PAUSED) {
-    // Render game objects
-    for (auto& kv : gameObjects) {
-      auto& obj = kv.second;
-      if (obj.model == nullptr) continue;
-
-      SimplePushConstantData push{};
-      push.transform = camera.getProjection() * camera.getView() * obj.transform.mat4();
-      push.color = obj.color;
-
-      vkCmdPushConstants(
-          commandBuffers[imageIndex],
-          pipelineLayout,
-          VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-          0,
-          sizeof(SimplePushConstantData),
-          &push);
-      obj.model->bind(commandBuffers[imageIndex]);
-      obj.model->draw(commandBuffers[imageIndex]);
-    }
-    
-    // Render projectiles
-    for (auto& kv : projectiles) {
-      auto& projectile = kv.second;
-      if (projectile.model == nullptr) continue;
-
-      SimplePushConstantData push{};
-      push.transform = camera.getProjection() * camera.getView() * projectile.transform.mat4();
-      push.color = projectile.color;
-
-      vkCmdPushConstants(
-          commandBuffers[imageIndex],
-          pipelineLayout,
-          VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-          0,
-          sizeof(SimplePushConstantData),
-          &push);
-      projectile.model->bind(commandBuffers[imageIndex]);
-      projectile.model->draw(commandBuffers[imageIndex]);
-    }
-    
-    // Render weapon (only when playing, not when paused)
-    if (gameState == GameState::PLAYING && weaponObject.model != nullptr) {
-      SimplePushConstantData push{};
-      push.transform = camera.getProjection() * camera.getView() * weaponObject.transform.mat4();
-      push.color = weaponObject.color;
-
-      vkCmdPushConstants(
-          commandBuffers[imageIndex],
-          pipelineLayout,
-          VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-          0,
-          sizeof(SimplePushConstantData),
-          &push);
-      weaponObject.model->bind(commandBuffers[imageIndex]);
-      weaponObject.model->draw(commandBuffers[imageIndex]);
+    if (!useStaticCommandCache) {
+      addCullCandidates(gameObjects);
     }
+    addCullCandidates(projectiles);
   }
 
-  vkCmdEndRenderPass(commandBuffers[imageIndex]);
-  if (vkEndCommandBuffer(commandBuffers[imageIndex]) != VK_SUCCESS) {
-    throw std::runtime_error("failed to record command buffer!");
+  frustumCuller.cull();
+  for (uint32_t index : frustumCuller.getVisible()) {
+    instanceBatcher.add(*cullCandidates[index], lvePipeline);
+  }
+
+  // Render weapon (only when playing, not when paused); it sits in front of the camera, so it is
+  // never culled
+  if (gameState == GameState::PLAYING) {
+    instanceBatcher.add(weaponObject, lvePipeline);
+  }
+}
+
+void SimpleGame::addCullCandidates(LveGameObject::Map &objects) {
+  for (auto &kv : objects) {
+    auto &obj = kv.second;
+    if (obj.model == nullptr) continue;
+    frustumCuller.add(*obj.model, obj.transform.mat4());
+    cullCandidates.push_back(&obj);
+  }
+}
+
+void SimpleGame::reportRenderStats(float frameTime) {
+  if (!showRenderStats && !showLatencyStats) return;
+
+  renderStatsTimer += frameTime;
+  if (renderStatsTimer < 1.0f) return;
+  renderStatsTimer = 0.0f;
+
+  if (showLatencyStats) {
+    auto latency = latencyTracker.takeStats();
+    std::cout << "Input latency (" << LveSwapChain::presentModeName(lveSwapChain->getPresentMode())
+              << ", " << lveSwapChain->imageCount() << " images, "
+              << lveSwapChain->getFramesInFlight() << " in flight): to present "
+              << latency.averagePresentMs << " ms avg / " << latency.maxPresentMs
+              << " max, to GPU done <= " << latency.averageCompleteMs << " ms avg / "
+              << latency.maxCompleteMs << " max over " << latency.presentedFrames << " frames"
+              << std::endl;
+  }
+  if (!showRenderStats) return;
+
+  const auto &stats = frustumCuller.getStats();
+  std::cout << "Culling: " << stats.tested << " tested, " << stats.culled << " culled, "
+            << instanceBatcher.getBatches().size() << " batches (SIMD width "
+            << LveFrustumCuller::SIMD_WIDTH << ")" << std::endl;
+  if (useStaticCommandCache) {
+    std::cout << "Static commands: " << staticBatcher.getBatches().size() << " batches, "
+              << staticCommandCache.getRecordCount() << " recordings so far" << std::endl;
+  }
+  auto shaderStats = lveDevice.shaderModuleCache().getStats();
+  std::cout << "Shader modules: " << shaderStats.moduleCount << " modules, " << shaderStats.hits
+            << " hits, " << shaderStats.misses << " misses, " << shaderStats.bytesLoaded
+            << " bytes loaded" << std::endl;
+  auto &allocator = lveDevice.memoryAllocator();
+  std::cout << "Device memory: " << allocator.getDeviceMemoryCount() << " of "
+            << lveDevice.properties.limits.maxMemoryAllocationCount << " allocations";
+  auto heapStats = allocator.getHeapStats();
+  for (size_t heap = 0; heap < heapStats.size(); heap++) {
+    const auto &stats = heapStats[heap];
+    if (stats.blockCount == 0 && stats.dedicatedCount == 0) continue;
+    std::cout << "; heap " << heap << ": " << stats.usedBytes / 1024 << " of "
+              << stats.blockBytes / 1024 << " KiB in " << stats.blockCount << " blocks ("
+              << stats.allocationCount << " allocations), " << stats.dedicatedBytes / 1024
+              << " KiB in " << stats.dedicatedCount << " dedicated";
+  }
+  std::cout << std::endl;
+  if (gpuProfiler.isSupported()) {
+    std::cout << "GPU (avg over " << LveGpuProfiler::AVERAGE_WINDOW << " frames):";
+    const char *separator = " ";
+    for (const auto &scope : gpuProfiler.getStats()) {
+      std::cout << separator << scope.name << " " << scope.averageMs << " ms";
+      if (scope.vertexInvocations > 0 || scope.fragmentInvocations > 0) {
+        std::cout << " (" << scope.vertexInvocations << " vertex / " << scope.fragmentInvocations
+                  << " fragment invocations)";
+      }
+      separator = ", ";
+    }
+    std::cout << std::endl;
   }
 }
 
@@ -489,6 +682,8 @@ void SimpleGame::handleShooting() {
 }
 
 void SimpleGame::updateProjectiles(float dt) {
+  LVE_PROFILE_ZONE("updateProjectiles");
+  LVE_PROFILE_COUNTER("projectiles", projectiles.size());
   for (auto& kv : projectiles) {
     auto& projectile = kv.second;
     
@@ -571,6 +766,94 @@ void SimpleGame::handleMenuInput() {
       std::cout << "Returned to Main Menu" << std::endl;
     }
     escapeKeyWasPressed = escapeKeyPressed;
+
+    // Display settings: 1-3 frames in flight, M cycles the present mode, L toggles latency stats
+    static const std::array<int, 3> framesInFlightKeys = {GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3};
+    static std::array<bool, 3> framesInFlightKeysWerePressed{};
+    for (size_t i = 0; i < framesInFlightKeys.size(); i++) {
+      bool keyPressed = glfwGetKey(window, framesInFlightKeys[i]) == GLFW_PRESS;
+      if (keyPressed && !framesInFlightKeysWerePressed[i]) {
+        LveSwapChain::Config config = swapChainConfig;
+        config.framesInFlight = static_cast<int>(i) + 1;
+        setSwapChainConfig(config);
+        displaySettings();
+      }
+      framesInFlightKeysWerePressed[i] = keyPressed;
+    }
+
+    static bool presentModeKeyWasPressed = false;
+    bool presentModeKeyPressed = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+    if (presentModeKeyPressed && !presentModeKeyWasPressed) {
+      static const std::array<VkPresentModeKHR, 4> presentModes = {
+          VK_PRESENT_MODE_FIFO_KHR,
+          VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+          VK_PRESENT_MODE_MAILBOX_KHR,
+          VK_PRESENT_MODE_IMMEDIATE_KHR};
+      size_t current = 0;
+      while (current < presentModes.size() && presentModes[current] != swapChainConfig.presentMode) {
+        current++;
+      }
+      LveSwapChain::Config config = swapChainConfig;
+      config.presentMode = presentModes[(current + 1) % presentModes.size()];
+      setSwapChainConfig(config);
+      displaySettings();
+    }
+    presentModeKeyWasPressed = presentModeKeyPressed;
+
+    static bool latencyKeyWasPressed = false;
+    bool latencyKeyPressed = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+    if (latencyKeyPressed && !latencyKeyWasPressed) {
+      showLatencyStats = !showLatencyStats;
+      latencyTracker.takeStats();
+      displaySettings();
+    }
+    latencyKeyWasPressed = latencyKeyPressed;
+
+    static bool timelineKeyWasPressed = false;
+    bool timelineKeyPressed = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (timelineKeyPressed && !timelineKeyWasPressed && frameTimeline != nullptr) {
+      LveSwapChain::Config config = swapChainConfig;
+      config.frameTimeline = config.frameTimeline != nullptr ? nullptr : frameTimeline.get();
+      setSwapChainConfig(config);
+      displaySettings();
+    }
+    timelineKeyWasPressed = timelineKeyPressed;
+
+    static bool lightingKeyWasPressed = false;
+    bool lightingKeyPressed = glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS;
+    if (lightingKeyPressed && !lightingKeyWasPressed) {
+      useLighting = !useLighting;
+      selectScenePipeline();
+      displaySettings();
+    }
+    lightingKeyWasPressed = lightingKeyPressed;
+
+    static bool recordingKeyWasPressed = false;
+    bool recordingKeyPressed = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+    if (recordingKeyPressed && !recordingKeyWasPressed) {
+      useParallelRecording = !useParallelRecording;
+      displaySettings();
+    }
+    recordingKeyWasPressed = recordingKeyPressed;
+
+    static bool staticCacheKeyWasPressed = false;
+    bool staticCacheKeyPressed = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (staticCacheKeyPressed && !staticCacheKeyWasPressed) {
+      useStaticCommandCache = !useStaticCommandCache;
+      // Recordings from an earlier stretch with the cache on may predate scene changes
+      staticCommandCache.invalidate();
+      displaySettings();
+    }
+    staticCacheKeyWasPressed = staticCacheKeyPressed;
+
+    static bool renderStatsKeyWasPressed = false;
+    bool renderStatsKeyPressed = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (renderStatsKeyPressed && !renderStatsKeyWasPressed) {
+      showRenderStats = !showRenderStats;
+      renderStatsTimer = 0.0f;
+      displaySettings();
+    }
+    renderStatsKeyWasPressed = renderStatsKeyPressed;
     return;
   }
   
@@ -757,6 +1040,29 @@ void SimpleGame::displaySettings() {
   std::cout << "              P - Pause/Resume game                 " << std::endl;
   std::cout << "              ESC - Return to menu                  " << std::endl;
   std::cout << "\n" << std::endl;
+  std::cout << "                     DISPLAY:                       " << std::endl;
+  std::cout << "\n" << std::endl;
+  std::cout << "              M - Present mode: "
+            << LveSwapChain::presentModeName(swapChainConfig.presentMode) << std::endl;
+  std::cout << "              1/2/3 - Frames in flight: " << swapChainConfig.framesInFlight
+            << std::endl;
+  std::cout << "              L - Latency stats: " << (showLatencyStats ? "on" : "off")
+            << std::endl;
+  std::cout << "              T - Frame sync: "
+            << (frameTimeline == nullptr                     ? "fences (no timeline support)"
+                : swapChainConfig.frameTimeline != nullptr ? "timeline semaphore"
+                                                           : "fences")
+            << std::endl;
+  std::cout << "              K - Lighting: " << (useLighting ? "on" : "off") << " ("
+            << pipelineManager.getPermutationCount() << " pipeline permutations)" << std::endl;
+  std::cout << "              R - Command recording: "
+            << (useParallelRecording ? "parallel (" : "inline (") << threadPool.getThreadCount()
+            << " worker threads)" << std::endl;
+  std::cout << "              C - Static command cache: "
+            << (useStaticCommandCache ? "on" : "off") << std::endl;
+  std::cout << "              F - Render stats: " << (showRenderStats ? "on" : "off")
+            << " (culling, shader modules, memory, GPU times)" << std::endl;
+  std::cout << "\n" << std::endl;
   std::cout << "                    GAME INFO:                      " << std::endl;
   std::cout << "\n" << std::endl;
   std::cout << "              • Physics enabled with gravity        " << std::endl;
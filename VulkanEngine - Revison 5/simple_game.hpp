@@ -1,10 +1,22 @@
 #pragma once
 
+#include "ve_buffer.hpp"
 #include "ve_camera.hpp"
+#include "ve_descriptors.hpp"
 #include "ve_device.hpp"
+#include "ve_frame_command_pools.hpp"
+#include "ve_frustum_culler.hpp"
 #include "ve_game_object.hpp"
+#include "ve_geometry_pool.hpp"
+#include "ve_gpu_profiler.hpp"
+#include "ve_instance_batcher.hpp"
+#include "ve_latency_tracker.hpp"
+#include "ve_parallel_recorder.hpp"
 #include "ve_pipeline.hpp"
+#include "ve_pipeline_manager.hpp"
+#include "ve_static_command_cache.hpp"
 #include "ve_swap_chain.hpp"
+#include "ve_thread_pool.hpp"
 #include "ve_window.hpp"
 #include "keyboard_movement_controller.hpp"
 
@@ -24,6 +36,11 @@ class SimpleGame {
  public:
   static constexpr int WIDTH = 900;
   static constexpr int HEIGHT = 660;
+  static constexpr float NEAR_PLANE = 0.1f;
+  static constexpr float FAR_PLANE = 10.0f;
+  // Specialization constant ids declared in shaders/simpleShader.vert and .frag
+  static constexpr uint32_t SPEC_USE_VERTEX_COLOR = 0;
+  static constexpr uint32_t SPEC_USE_LIGHTING = 1;
 
   SimpleGame();
   ~SimpleGame();
@@ -35,13 +52,22 @@ class SimpleGame {
 
  private:
   void loadGameObjects();
+  void createGlobalDescriptors();
   void createPipelineLayout();
   void createPipeline();
-  void createCommandBuffers();
-  void freeCommandBuffers();
+  // Requests the scene pipeline permutation matching the current settings
+  void selectScenePipeline();
   void drawFrame();
   void recreateSwapChain();
   void recordCommandBuffer(int imageIndex);
+  // Viewport, scissor and global descriptor set; needed again in every secondary buffer
+  void bindFrameState(VkCommandBuffer commandBuffer, int frameIndex);
+  void recordStaticScene(VkCommandBuffer commandBuffer, int frameIndex);
+  void collectInstances();
+  void addCullCandidates(LveGameObject::Map &objects);
+  void reportRenderStats(float frameTime);
+  // Takes effect at the start of the next frame, by recreating the swap chain
+  void setSwapChainConfig(const LveSwapChain::Config &config);
   void updateProjectiles(float dt);
   void handleShooting();
   void updateWeapon();
@@ -55,10 +81,65 @@ class SimpleGame {
 
   ve_window lveWindow{WIDTH, HEIGHT, "Vulkan FPS Game!"};
   LveDevice lveDevice{lveWindow};
+  // Null when the device lacks timeline semaphores; the swap chain then paces frames with fences
+  std::unique_ptr<LveFrameTimeline> frameTimeline;
   std::unique_ptr<LveSwapChain> lveSwapChain;
-  std::unique_ptr<vePipeline> lvePipeline;
+  LveSwapChain::Config swapChainConfig{};
+  bool swapChainConfigChanged{false};
+  LvePipelineManager pipelineManager{lveDevice};
+  LvePipelineManager::Handle scenePipelineHandle{LvePipelineManager::INVALID_HANDLE};
+  // Every scene permutation requested for the current render pass, released when it is rebuilt
+  std::vector<LvePipelineManager::Handle> scenePipelinePermutations;
+  bool useLighting{false};
+  // The scene pipeline once it has compiled, nullptr until then; refreshed every frame
+  vePipeline *lvePipeline{nullptr};
   VkPipelineLayout pipelineLayout;
-  std::vector<VkCommandBuffer> commandBuffers;
+  // Primary command buffers come from one transient pool per frame in flight,
+  // reset wholesale once the frame's fence has signaled
+  LveFrameCommandPools frameCommandPools{lveDevice};
+  LveInstanceBatcher instanceBatcher{lveDevice};
+  // Shared vertex/index storage for every mesh; declared before the models so it outlives them
+  std::unique_ptr<LveGeometryPool> geometryPool;
+  // Every mesh lives in geometryPool, so they all share this layout, as does the scene pipeline.
+  // 16-bit positions are plenty for the level's simple shapes.
+  LveModel::VertexFormat sceneVertexFormat{LveModel::VertexFormat::QUANTIZED};
+  bool useIndirectDraw{true};
+
+  // Splits recording across worker threads (secondary command buffers) instead of recording the
+  // whole frame inline; takes precedence over useIndirectDraw, which is already a single call
+  LveThreadPool threadPool{};
+  LveParallelRecorder parallelRecorder{lveDevice, threadPool};
+  bool useParallelRecording{false};
+
+  // Static scenery (gameObjects) is recorded once per frame slot into cached secondaries and
+  // replayed until staticSceneGeneration changes or the swap chain is recreated; only dynamic
+  // objects are batched and recorded each frame. Static objects are not frustum culled this way.
+  // Bump staticSceneGeneration whenever gameObjects gains, loses or moves an object.
+  LveInstanceBatcher staticBatcher{lveDevice};
+  LveStaticCommandCache staticCommandCache{lveDevice};
+  uint64_t staticSceneGeneration{0};
+  bool useStaticCommandCache{false};
+
+  // Objects outside the camera frustum are dropped before batching; cullCandidates maps culler
+  // indices back to the objects they came from
+  LveFrustumCuller frustumCuller{};
+  std::vector<LveGameObject *> cullCandidates;
+
+  // Prints culling counters, GPU times and input latency once a second when enabled
+  bool showRenderStats{false};
+  bool showLatencyStats{false};
+  float renderStatsTimer{0.0f};
+  LveLatencyTracker latencyTracker{};
+  // GPU time per pass, with shader invocation counts where the device supports them; printed
+  // with the render stats
+  LveGpuProfiler gpuProfiler{lveDevice, true};
+
+  // Camera matrices, one aligned GlobalUbo slot per frame in flight in a persistently mapped
+  // buffer, each with its own descriptor set
+  std::unique_ptr<LveDescriptorPool> globalPool;
+  std::unique_ptr<LveDescriptorSetLayout> globalSetLayout;
+  std::unique_ptr<LveBuffer> globalUboBuffer;
+  std::vector<VkDescriptorSet> globalDescriptorSets;
 
   // Game objects and systems
   LveGameObject::Map gameObjects;
@@ -0,0 +1,161 @@
+#include "ve_buffer.hpp"
+
+// std
+#include <cassert>
+#include <cstring>
+
+namespace lve {
+
+/**
+ * Returns the minimum instance size required to be compatible with devices minOffsetAlignment
+ *
+ * @param instanceSize The size of an instance
+ * @param minOffsetAlignment The minimum required alignment, in bytes, for the offset member (eg
+ * minUniformBufferOffsetAlignment)
+ *
+ * @return instanceSize rounded up to the next multiple of minOffsetAlignment
+ */
+VkDeviceSize LveBuffer::getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment) {
+  if (minOffsetAlignment > 0) {
+    return (instanceSize + minOffsetAlignment - 1) & ~(minOffsetAlignment - 1);
+  }
+  return instanceSize;
+}
+
+LveBuffer::LveBuffer(
+    LveDevice &device,
+    VkDeviceSize instanceSize,
+    uint32_t instanceCount,
+    VkBufferUsageFlags usageFlags,
+    VkMemoryPropertyFlags memoryPropertyFlags,
+    VkDeviceSize minOffsetAlignment)
+    : lveDevice{device},
+      instanceCount{instanceCount},
+      instanceSize{instanceSize},
+      usageFlags{usageFlags},
+      memoryPropertyFlags{memoryPropertyFlags} {
+  alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
+  bufferSize = alignmentSize * instanceCount;
+  device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation);
+}
+
+LveBuffer::~LveBuffer() {
+  unmap();
+  // Frames still in flight may read the buffer, so it is released once they complete
+  VkDevice device = lveDevice.device();
+  LveMemoryAllocator *allocator = &lveDevice.memoryAllocator();
+  VkBuffer retiredBuffer = buffer;
+  LveAllocation retiredAllocation = allocation;
+  lveDevice.deletionQueue().push([device, allocator, retiredBuffer, retiredAllocation]() {
+    vkDestroyBuffer(device, retiredBuffer, nullptr);
+    allocator->free(retiredAllocation);
+  });
+}
+
+/**
+ * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
+ *
+ * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
+ * buffer range.
+ * @param offset (Optional) Byte offset from beginning
+ *
+ * @note Host-visible memory blocks stay mapped by the allocator, so this only points into them
+ *
+ * @return VK_ERROR_MEMORY_MAP_FAILED if the buffer's memory is not host visible
+ */
+VkResult LveBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
+  assert(buffer && allocation.memory && "Called map on buffer before create");
+  if (allocation.mapped == nullptr) {
+    return VK_ERROR_MEMORY_MAP_FAILED;
+  }
+  mapped = static_cast<char *>(allocation.mapped) + offset;
+  return VK_SUCCESS;
+}
+
+/**
+ * Unmap a mapped memory range
+ *
+ * @note The memory itself stays mapped until the allocator releases its block
+ */
+void LveBuffer::unmap() { mapped = nullptr; }
+
+/**
+ * Copies the specified data to the mapped buffer. Default value writes whole buffer range
+ *
+ * @param data Pointer to the data to copy
+ * @param size (Optional) Size of the data to copy. Pass VK_WHOLE_SIZE to flush the complete buffer
+ * range.
+ * @param offset (Optional) Byte offset from beginning of mapped region
+ */
+void LveBuffer::writeToBuffer(const void *data, VkDeviceSize size, VkDeviceSize offset) {
+  assert(mapped && "Cannot copy to unmapped buffer");
+
+  if (size == VK_WHOLE_SIZE) {
+    memcpy(mapped, data, bufferSize);
+  } else {
+    char *memOffset = (char *)mapped;
+    memOffset += offset;
+    memcpy(memOffset, data, size);
+  }
+}
+
+/**
+ * Flush a memory range of the buffer to make it visible to the device
+ *
+ * @note Only required for non-coherent memory
+ *
+ * @param size (Optional) Size of the memory range to flush. Pass VK_WHOLE_SIZE to flush the
+ * complete buffer range.
+ * @param offset (Optional) Byte offset from beginning
+ *
+ * @return VkResult of the flush call
+ */
+VkResult LveBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
+  return lveDevice.memoryAllocator().flush(allocation, size, offset);
+}
+
+/**
+ * Create a buffer info descriptor
+ *
+ * @param size (Optional) Size of the memory range of the descriptor
+ * @param offset (Optional) Byte offset from beginning
+ *
+ * @return VkDescriptorBufferInfo of specified offset and range
+ */
+VkDescriptorBufferInfo LveBuffer::descriptorInfo(VkDeviceSize size, VkDeviceSize offset) {
+  return VkDescriptorBufferInfo{
+      buffer,
+      offset,
+      size,
+  };
+}
+
+/**
+ * Copies "instanceSize" bytes of data to the mapped buffer at an offset of index * alignmentSize
+ *
+ * @param data Pointer to the data to copy
+ * @param index Used in offset calculation
+ */
+void LveBuffer::writeToIndex(const void *data, int index) {
+  writeToBuffer(data, instanceSize, index * alignmentSize);
+}
+
+/**
+ * Flush the memory range at index * alignmentSize of the buffer to make it visible to the device
+ *
+ * @param index Used in offset calculation
+ */
+VkResult LveBuffer::flushIndex(int index) { return flush(alignmentSize, index * alignmentSize); }
+
+/**
+ * Create a buffer info descriptor
+ *
+ * @param index Specifies the region given by index * alignmentSize
+ *
+ * @return VkDescriptorBufferInfo for instance at index
+ */
+VkDescriptorBufferInfo LveBuffer::descriptorInfoForIndex(int index) {
+  return descriptorInfo(alignmentSize, index * alignmentSize);
+}
+
+}  // namespace lve
@@ -4,6 +4,9 @@
 
 #include <glm/glm.hpp>
 
+// std
+#include <array>
+
 namespace lve {
 
 class LveCamera {
@@ -22,6 +25,10 @@ class LveCamera {
   const glm::mat4& getView() const { return viewMatrix; }
   const glm::mat4& getInverseView() const { return inverseViewMatrix; }
 
+  // World-space planes (xyz = inward normal, w = distance) in the order left, right, bottom, top,
+  // near, far; a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all six
+  std::array<glm::vec4, 6> getFrustumPlanes() const;
+
  private:
   glm::mat4 projectionMatrix{1.0f};
   glm::mat4 viewMatrix{1.0f};
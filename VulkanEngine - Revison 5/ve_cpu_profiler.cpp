@@ -0,0 +1,145 @@
+#include "ve_cpu_profiler.hpp"
+
+#ifdef LVE_PROFILE
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+namespace lve {
+
+std::mutex LveCpuProfiler::registryMutex;
+std::vector<std::unique_ptr<LveCpuProfiler::ThreadBuffer>> LveCpuProfiler::threadBuffers;
+
+namespace {
+
+void writeJsonString(std::ostream &out, const char *text) {
+  out << '"';
+  for (const char *c = text; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      out << '\\' << *c;
+    } else if (static_cast<unsigned char>(*c) >= 0x20) {
+      out << *c;
+    }
+  }
+  out << '"';
+}
+
+}  // namespace
+
+uint64_t LveCpuProfiler::now() {
+  static const auto epoch = std::chrono::steady_clock::now();
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - epoch)
+          .count());
+}
+
+void LveCpuProfiler::zone(const char *name, uint64_t startNs, uint64_t endNs) {
+  record(Event{name, startNs, endNs - startNs, EventType::ZONE});
+}
+
+void LveCpuProfiler::counter(const char *name, double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  record(Event{name, now(), bits, EventType::COUNTER});
+}
+
+void LveCpuProfiler::frameMark() { record(Event{"frame", now(), 0, EventType::FRAME}); }
+
+void LveCpuProfiler::setThreadName(const char *name) {
+  threadBuffer().threadName.store(name, std::memory_order_release);
+}
+
+void LveCpuProfiler::record(const Event &event) {
+  ThreadBuffer &buffer = threadBuffer();
+  // Only this thread writes head, so a relaxed load sees its own latest value
+  uint64_t head = buffer.head.load(std::memory_order_relaxed);
+  buffer.events[head % EVENTS_PER_THREAD] = event;
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+LveCpuProfiler::ThreadBuffer &LveCpuProfiler::threadBuffer() {
+  // The registry lock is taken once per thread, on its first event
+  thread_local ThreadBuffer *buffer = nullptr;
+  if (buffer == nullptr) {
+    auto newBuffer = std::make_unique<ThreadBuffer>();
+    std::lock_guard<std::mutex> lock{registryMutex};
+    newBuffer->threadId = static_cast<uint32_t>(threadBuffers.size()) + 1;
+    buffer = newBuffer.get();
+    threadBuffers.push_back(std::move(newBuffer));
+  }
+  return *buffer;
+}
+
+bool LveCpuProfiler::writeChromeTrace(const std::string &path) {
+  std::ofstream file{path};
+  if (!file.is_open()) return false;
+
+  // Timestamps are in microseconds; keep the nanosecond fraction
+  file << std::fixed << std::setprecision(3);
+  file << "{\"traceEvents\":[";
+  bool first = true;
+  auto beginEvent = [&file, &first]() {
+    file << (first ? "\n" : ",\n");
+    first = false;
+  };
+
+  std::lock_guard<std::mutex> lock{registryMutex};
+  std::vector<Event> events;
+  for (const auto &buffer : threadBuffers) {
+    // The slot after head may be mid-write, and the owner keeps writing while this copies, so
+    // events are copied first and then trimmed to those that cannot have been overwritten since
+    uint64_t head = buffer->head.load(std::memory_order_acquire);
+    uint64_t begin = head > EVENTS_PER_THREAD - 1 ? head - (EVENTS_PER_THREAD - 1) : 0;
+    events.clear();
+    for (uint64_t i = begin; i < head; i++) {
+      events.push_back(buffer->events[i % EVENTS_PER_THREAD]);
+    }
+    uint64_t headAfterCopy = buffer->head.load(std::memory_order_acquire);
+    uint64_t firstValid =
+        headAfterCopy > EVENTS_PER_THREAD - 1 ? headAfterCopy - (EVENTS_PER_THREAD - 1) : 0;
+    size_t skip = static_cast<size_t>(std::min(std::max(firstValid, begin) - begin, head - begin));
+
+    const char *threadName = buffer->threadName.load(std::memory_order_acquire);
+    if (threadName != nullptr) {
+      beginEvent();
+      file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->threadId
+           << ",\"args\":{\"name\":";
+      writeJsonString(file, threadName);
+      file << "}}";
+    }
+
+    for (size_t i = skip; i < events.size(); i++) {
+      const Event &event = events[i];
+      beginEvent();
+      file << "{\"name\":";
+      writeJsonString(file, event.name);
+      file << ",\"pid\":1,\"tid\":" << buffer->threadId
+           << ",\"ts\":" << static_cast<double>(event.startNs) / 1000.0;
+      switch (event.type) {
+        case EventType::ZONE:
+          file << ",\"ph\":\"X\",\"dur\":" << static_cast<double>(event.payload) / 1000.0 << "}";
+          break;
+        case EventType::COUNTER: {
+          double value;
+          std::memcpy(&value, &event.payload, sizeof(value));
+          file << ",\"ph\":\"C\",\"args\":{\"value\":" << value << "}}";
+          break;
+        }
+        case EventType::FRAME:
+          file << ",\"ph\":\"i\",\"s\":\"g\"}";
+          break;
+      }
+    }
+  }
+
+  file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return file.good();
+}
+
+}  // namespace lve
+
+#endif
@@ -0,0 +1,109 @@
+#pragma once
+
+// CPU instrumentation: scoped zones, counters and frame markers, recorded per thread and written
+// out as Chrome trace JSON (open in chrome://tracing or ui.perfetto.dev). Only compiled in when
+// LVE_PROFILE is defined (`make profile`); otherwise every macro expands to nothing, so the
+// instrumentation can stay in the code. Names must be string literals or otherwise outlive the
+// profiler, as only the pointer is recorded.
+//
+//   LVE_PROFILE_ZONE("drawFrame");            // until the end of the enclosing block
+//   LVE_PROFILE_COUNTER("projectiles", n);
+//   LVE_PROFILE_FRAME();                      // once per frame, on the main thread
+//   LVE_PROFILE_THREAD_NAME("main");
+//   LVE_PROFILE_WRITE_TRACE("cpu_trace.json");
+
+#ifdef LVE_PROFILE
+
+// std
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+class LveCpuProfiler {
+ public:
+  // Events kept per thread; older ones are overwritten
+  static constexpr uint32_t EVENTS_PER_THREAD = 1 << 16;
+
+  // Records the time from construction to destruction as one complete event
+  class Zone {
+   public:
+    explicit Zone(const char *name) : name{name}, start{now()} {}
+    ~Zone() { LveCpuProfiler::zone(name, start, now()); }
+
+    Zone(const Zone &) = delete;
+    Zone &operator=(const Zone &) = delete;
+
+   private:
+    const char *name;
+    uint64_t start;
+  };
+
+  static void zone(const char *name, uint64_t startNs, uint64_t endNs);
+  static void counter(const char *name, double value);
+  static void frameMark();
+  // Labels the calling thread in the trace
+  static void setThreadName(const char *name);
+
+  // Writes everything still held in the rings. Safe to call while other threads keep recording:
+  // events overwritten during the copy are dropped.
+  static bool writeChromeTrace(const std::string &path);
+
+  // Nanoseconds since the profiler's epoch (the first call)
+  static uint64_t now();
+
+ private:
+  enum class EventType : uint8_t { ZONE, COUNTER, FRAME };
+
+  struct Event {
+    const char *name;
+    uint64_t startNs;
+    // Zone duration, or the counter's value (bit-cast) for counters
+    uint64_t payload;
+    EventType type;
+  };
+
+  // Written only by its thread. head counts every event ever written; the slot for event i is
+  // i % EVENTS_PER_THREAD, and head is published with release ordering after the slot is filled.
+  struct ThreadBuffer {
+    uint32_t threadId = 0;
+    std::atomic<const char *> threadName{nullptr};
+    std::atomic<uint64_t> head{0};
+    std::array<Event, EVENTS_PER_THREAD> events{};
+  };
+
+  static void record(const Event &event);
+  static ThreadBuffer &threadBuffer();
+
+  // Buffers outlive their threads so a trace written later still has their events
+  static std::mutex registryMutex;
+  static std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+};
+
+}  // namespace lve
+
+#define LVE_PROFILE_CONCAT_INNER(a, b) a##b
+#define LVE_PROFILE_CONCAT(a, b) LVE_PROFILE_CONCAT_INNER(a, b)
+#define LVE_PROFILE_ZONE(name) \
+  ::lve::LveCpuProfiler::Zone LVE_PROFILE_CONCAT(lveProfileZone, __LINE__) { name }
+#define LVE_PROFILE_COUNTER(name, value) \
+  ::lve::LveCpuProfiler::counter(name, static_cast<double>(value))
+#define LVE_PROFILE_FRAME() ::lve::LveCpuProfiler::frameMark()
+#define LVE_PROFILE_THREAD_NAME(name) ::lve::LveCpuProfiler::setThreadName(name)
+#define LVE_PROFILE_WRITE_TRACE(path) ::lve::LveCpuProfiler::writeChromeTrace(path)
+
+#else
+
+#define LVE_PROFILE_ZONE(name) ((void)0)
+#define LVE_PROFILE_COUNTER(name, value) ((void)0)
+#define LVE_PROFILE_FRAME() ((void)0)
+#define LVE_PROFILE_THREAD_NAME(name) ((void)0)
+#define LVE_PROFILE_WRITE_TRACE(path) ((void)0)
+
+#endif
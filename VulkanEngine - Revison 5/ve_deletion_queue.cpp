@@ -0,0 +1,30 @@
+#include "ve_deletion_queue.hpp"
+
+// std
+#include <utility>
+
+namespace lve {
+
+void LveDeletionQueue::push(std::function<void()> deleter) {
+  entries.push_back({submitFrame, std::move(deleter)});
+}
+
+void LveDeletionQueue::collect(uint64_t completedFrame) {
+  // Tags never decrease, so completed entries are always at the front
+  while (!entries.empty() && entries.front().frame <= completedFrame) {
+    auto deleter = std::move(entries.front().deleter);
+    entries.pop_front();
+    deleter();
+  }
+}
+
+void LveDeletionQueue::flush() {
+  // A deleter may retire further objects (e.g. a swap chain's buffers), so drain until empty
+  while (!entries.empty()) {
+    auto deleter = std::move(entries.front().deleter);
+    entries.pop_front();
+    deleter();
+  }
+}
+
+}  // namespace lve
@@ -0,0 +1,53 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace lve {
+
+// Defers destroying Vulkan objects until the GPU has finished every frame that could still be using
+// them. Each entry is tagged with the frame number the next submission will carry; whoever submits
+// frames (LveSwapChain, LveOffscreenTarget) advances that number and reports completed frames,
+// which runs the entries they covered. Not thread-safe: push from the thread that submits frames.
+class LveDeletionQueue {
+ public:
+  LveDeletionQueue() = default;
+  ~LveDeletionQueue() { flush(); }
+
+  LveDeletionQueue(const LveDeletionQueue &) = delete;
+  LveDeletionQueue &operator=(const LveDeletionQueue &) = delete;
+
+  // Runs deleter once the frame currently being recorded (and every earlier one) has completed
+  void push(std::function<void()> deleter);
+
+  // Destroys object on the same schedule as push
+  template <typename T>
+  void retire(std::unique_ptr<T> object) {
+    if (object == nullptr) return;
+    T *retired = object.release();
+    push([retired]() { delete retired; });
+  }
+
+  // Frame number the next submission will carry; entries pushed from now on are tagged with it
+  void setSubmitFrame(uint64_t frame) { submitFrame = frame; }
+  // Runs every entry tagged with completedFrame or earlier, oldest first
+  void collect(uint64_t completedFrame);
+  // Runs everything regardless of frame. Only safe once the device is idle.
+  void flush();
+
+  size_t size() const { return entries.size(); }
+
+ private:
+  struct Entry {
+    uint64_t frame;
+    std::function<void()> deleter;
+  };
+
+  std::deque<Entry> entries;
+  uint64_t submitFrame = 1;
+};
+
+}  // namespace lve
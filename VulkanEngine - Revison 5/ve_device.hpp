@@ -1,13 +1,19 @@
 #pragma once
 
+#include "ve_deletion_queue.hpp"
+#include "ve_memory_allocator.hpp"
+#include "ve_shader_module_cache.hpp"
 #include "ve_window.hpp"
 
 // std lib headers
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace lve {
 
+class LveUploadManager;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -17,8 +23,11 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  // A transfer-only family (usually a DMA engine), if the device has one; optional
+  uint32_t transferFamily;
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool transferFamilyHasValue = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -30,7 +39,12 @@ class LveDevice {
   const bool enableValidationLayers = true;
 #endif
 
+  // Where the pipeline cache is loaded from at startup and saved to at shutdown
+  static constexpr const char *PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
   LveDevice(ve_window &window);
+  // Headless: no window, surface or swap chain extension, for offscreen rendering only
+  LveDevice();
   ~LveDevice();
 
   // Not copyable or movable
@@ -42,12 +56,31 @@ class LveDevice {
   VkCommandPool getCommandPool() { return commandPool; }
   VkDevice device() { return device_; }
   VkSurfaceKHR surface() { return surface_; }
+  bool isHeadless() const { return window == nullptr; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  // The dedicated transfer queue when the device has a transfer-only family, else the graphics
+  // queue. Resources written on a dedicated one need a queue family ownership transfer.
+  VkQueue transferQueue() { return transferQueue_; }
+  bool hasDedicatedTransferQueue() const { return transferQueue_ != graphicsQueue_; }
+  // Objects that in-flight frames may still use are destroyed through this instead of directly
+  LveDeletionQueue &deletionQueue() { return deletionQueue_; }
+  // Shared by every pipeline creation; internally synchronized, so worker threads may use it too
+  VkPipelineCache pipelineCache() { return pipelineCache_; }
+  // Writes the pipeline cache to PIPELINE_CACHE_PATH; also done on destruction
+  void savePipelineCache();
+  // Shader modules shared by every pipeline built from the same SPIR-V
+  LveShaderModuleCache &shaderModuleCache() { return *shaderModuleCache_; }
+  // Every buffer and image allocation goes through this rather than vkAllocateMemory
+  LveMemoryAllocator &memoryAllocator() { return *memoryAllocator_; }
+  // Batched staging copies into device-local buffers; use instead of copyBuffer, which stalls
+  LveUploadManager &uploadManager() { return *uploadManager_; }
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
   QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
+  // Meaningful bits in timestamps written on the graphics queue; 0 if it cannot write them
+  uint32_t graphicsTimestampValidBits();
   VkFormat findSupportedFormat(
       const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
@@ -57,7 +90,7 @@ class LveDevice {
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
+      LveAllocation &bufferAllocation);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -68,9 +101,14 @@ class LveDevice {
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
-      VkDeviceMemory &imageMemory);
+      LveAllocation &imageAllocation);
+
+  // Vulkan 1.2 timeline semaphores, enabled when both the instance and the device support them
+  bool supportsTimelineSemaphores() const { return timelineSemaphoresEnabled; }
 
   VkPhysicalDeviceProperties properties;
+  // Features actually enabled on the logical device (optional ones depend on hardware support)
+  VkPhysicalDeviceFeatures enabledFeatures{};
 
  private:
   void createInstance();
@@ -79,27 +117,40 @@ class LveDevice {
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  void createPipelineCache();
+  void createMemoryAllocator();
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
   std::vector<const char *> getRequiredExtensions();
+  std::vector<const char *> getRequiredDeviceExtensions() const;
   bool checkValidationLayerSupport();
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isPipelineCacheCompatible(const std::vector<char> &cacheData) const;
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
   VkInstance instance;
+  // Version the instance was created with: the loader's version, capped at 1.2
+  uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+  bool timelineSemaphoresEnabled = false;
   VkDebugUtilsMessengerEXT debugMessenger;
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-  ve_window &window;
+  ve_window *window = nullptr;
   VkCommandPool commandPool;
 
   VkDevice device_;
-  VkSurfaceKHR surface_;
+  VkSurfaceKHR surface_ = VK_NULL_HANDLE;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
+  LveDeletionQueue deletionQueue_;
+  VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+  std::unique_ptr<LveShaderModuleCache> shaderModuleCache_;
+  std::unique_ptr<LveMemoryAllocator> memoryAllocator_;
+  std::unique_ptr<LveUploadManager> uploadManager_;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -0,0 +1,64 @@
+#include "ve_frame_command_pools.hpp"
+
+#include "ve_swap_chain.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+LveFrameCommandPools::LveFrameCommandPools(LveDevice &device) : lveDevice{device} {
+  QueueFamilyIndices queueFamilyIndices = lveDevice.findPhysicalQueueFamilies();
+
+  frames.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  for (auto &frame : frames) {
+    // No RESET_COMMAND_BUFFER_BIT: buffers are only ever reset together with their pool
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &frame.commandPool) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create frame command pool!");
+    }
+
+    frame.primaryCommandBuffer = allocate(frame.commandPool);
+  }
+}
+
+LveFrameCommandPools::~LveFrameCommandPools() {
+  // Destroying a pool frees the command buffers allocated from it
+  for (auto &frame : frames) {
+    vkDestroyCommandPool(lveDevice.device(), frame.commandPool, nullptr);
+  }
+}
+
+void LveFrameCommandPools::reset(int frameIndex) {
+  assert(frameIndex >= 0 && frameIndex < LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+  FrameCommands &frame = frames[frameIndex];
+  vkResetCommandPool(lveDevice.device(), frame.commandPool, 0);
+}
+
+VkCommandBuffer LveFrameCommandPools::getPrimaryCommandBuffer(int frameIndex) const {
+  assert(frameIndex >= 0 && frameIndex < LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  return frames[frameIndex].primaryCommandBuffer;
+}
+
+VkCommandBuffer LveFrameCommandPools::allocate(VkCommandPool commandPool) {
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = commandPool;
+  allocInfo.commandBufferCount = 1;
+
+  VkCommandBuffer commandBuffer;
+  if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate frame command buffer!");
+  }
+  return commandBuffer;
+}
+
+}  // namespace lve
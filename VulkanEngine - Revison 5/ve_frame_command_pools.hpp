@@ -0,0 +1,40 @@
+#pragma once
+
+#include "ve_device.hpp"
+
+// std
+#include <vector>
+
+namespace lve {
+
+// One transient command pool per frame in flight. Nothing recorded for a frame outlives the frame,
+// so instead of resetting buffers one by one the whole pool is reset once the frame's fence has
+// signaled, and every buffer it handed out is recycled in a single call.
+class LveFrameCommandPools {
+ public:
+  LveFrameCommandPools(LveDevice &device);
+  ~LveFrameCommandPools();
+
+  LveFrameCommandPools(const LveFrameCommandPools &) = delete;
+  LveFrameCommandPools &operator=(const LveFrameCommandPools &) = delete;
+
+  // Recycles everything handed out for frameIndex last time round. Call only once the frame's
+  // fence has signaled, before recording anything for it.
+  void reset(int frameIndex);
+
+  // The frame's main primary buffer, in the initial state after reset()
+  VkCommandBuffer getPrimaryCommandBuffer(int frameIndex) const;
+
+ private:
+  struct FrameCommands {
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer primaryCommandBuffer = VK_NULL_HANDLE;
+  };
+
+  VkCommandBuffer allocate(VkCommandPool commandPool);
+
+  LveDevice &lveDevice;
+  std::vector<FrameCommands> frames;
+};
+
+}  // namespace lve
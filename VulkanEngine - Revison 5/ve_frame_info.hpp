@@ -0,0 +1,15 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace lve {
+
+// Camera matrices shared by every draw in a frame (set 0, binding 0 in simpleShader.vert).
+// Per-object transform and color arrive as instance attributes (LveModel::InstanceData).
+struct GlobalUbo {
+  glm::mat4 projection{1.0f};
+  glm::mat4 view{1.0f};
+  glm::mat4 projectionView{1.0f};
+};
+
+}  // namespace lve
@@ -0,0 +1,64 @@
+#include "ve_frame_timeline.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace lve {
+
+LveFrameTimeline::LveFrameTimeline(LveDevice &device) : lveDevice{device} {
+  if (!lveDevice.supportsTimelineSemaphores()) {
+    throw std::runtime_error("timeline semaphores are not supported by this device!");
+  }
+
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+
+  if (vkCreateSemaphore(lveDevice.device(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create frame timeline semaphore!");
+  }
+}
+
+LveFrameTimeline::~LveFrameTimeline() {
+  vkDestroySemaphore(lveDevice.device(), semaphore, nullptr);
+}
+
+uint64_t LveFrameTimeline::getCompletedValue() {
+  uint64_t value = 0;
+  if (vkGetSemaphoreCounterValue(lveDevice.device(), semaphore, &value) != VK_SUCCESS) {
+    throw std::runtime_error("failed to read frame timeline value!");
+  }
+  completedValue = value;
+  return completedValue;
+}
+
+bool LveFrameTimeline::isComplete(uint64_t value) {
+  if (value <= completedValue) return true;
+  return value <= getCompletedValue();
+}
+
+bool LveFrameTimeline::wait(uint64_t value, uint64_t timeout) {
+  if (isComplete(value)) return true;
+
+  VkSemaphoreWaitInfo waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &semaphore;
+  waitInfo.pValues = &value;
+
+  VkResult result = vkWaitSemaphores(lveDevice.device(), &waitInfo, timeout);
+  if (result == VK_TIMEOUT) return false;
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to wait for frame timeline!");
+  }
+  completedValue = std::max(completedValue, value);
+  return true;
+}
+
+}  // namespace lve
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ve_device.hpp"
+
+// std
+#include <cstdint>
+#include <limits>
+
+namespace lve {
+
+// A Vulkan 1.2 timeline semaphore used as a frame counter. Every frame submission signals the next
+// value, so "has frame N finished on the GPU?" is a single comparison against the counter instead
+// of a fence per frame slot. Resources retired by frame N (uploads, deletions, readbacks) can be
+// tagged with N and reclaimed once the counter reaches it. Requires
+// LveDevice::supportsTimelineSemaphores().
+class LveFrameTimeline {
+ public:
+  LveFrameTimeline(LveDevice &device);
+  ~LveFrameTimeline();
+
+  LveFrameTimeline(const LveFrameTimeline &) = delete;
+  LveFrameTimeline &operator=(const LveFrameTimeline &) = delete;
+
+  VkSemaphore getSemaphore() const { return semaphore; }
+
+  // Value the next submission will signal, i.e. the number of the frame being recorded. Frame
+  // numbers start at 1; 0 is the semaphore's initial value and counts as already complete.
+  uint64_t getPendingValue() const { return submittedValue + 1; }
+  // Value signaled by the most recent submission
+  uint64_t getSubmittedValue() const { return submittedValue; }
+  // Hands out getPendingValue() for a submission to signal
+  uint64_t advance() { return ++submittedValue; }
+
+  // Polls the GPU; never blocks
+  uint64_t getCompletedValue();
+  // Checks the last polled value first, so asking about old frames costs no API call
+  bool isComplete(uint64_t value);
+  // Blocks until value has been signaled. Returns false if the timeout elapsed first.
+  bool wait(uint64_t value, uint64_t timeout = std::numeric_limits<uint64_t>::max());
+
+ private:
+  LveDevice &lveDevice;
+  VkSemaphore semaphore = VK_NULL_HANDLE;
+  uint64_t submittedValue = 0;
+  uint64_t completedValue = 0;
+};
+
+}  // namespace lve
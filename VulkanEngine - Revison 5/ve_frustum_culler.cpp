@@ -0,0 +1,122 @@
+#include "ve_frustum_culler.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define LVE_CULL_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define LVE_CULL_SSE
+#endif
+
+namespace lve {
+
+#if defined(LVE_CULL_AVX)
+const uint32_t LveFrustumCuller::SIMD_WIDTH = 8;
+#elif defined(LVE_CULL_SSE)
+const uint32_t LveFrustumCuller::SIMD_WIDTH = 4;
+#else
+const uint32_t LveFrustumCuller::SIMD_WIDTH = 1;
+#endif
+
+void LveFrustumCuller::begin(const std::array<glm::vec4, 6> &frustumPlanes) {
+  planes = frustumPlanes;
+  centerX.clear();
+  centerY.clear();
+  centerZ.clear();
+  radius.clear();
+  visible.clear();
+  stats = {};
+}
+
+uint32_t LveFrustumCuller::add(const LveModel &model, const glm::mat4 &modelMatrix) {
+  const auto &sphere = model.getBoundingSphere();
+  glm::vec4 center = modelMatrix * glm::vec4{sphere.center, 1.0f};
+
+  // Non-uniform scale stretches the sphere by the longest basis vector
+  float maxScaleSquared = glm::max(
+      glm::dot(glm::vec3{modelMatrix[0]}, glm::vec3{modelMatrix[0]}),
+      glm::max(
+          glm::dot(glm::vec3{modelMatrix[1]}, glm::vec3{modelMatrix[1]}),
+          glm::dot(glm::vec3{modelMatrix[2]}, glm::vec3{modelMatrix[2]})));
+  return addSphere(glm::vec3{center}, sphere.radius * glm::sqrt(maxScaleSquared));
+}
+
+uint32_t LveFrustumCuller::addSphere(const glm::vec3 &center, float sphereRadius) {
+  centerX.push_back(center.x);
+  centerY.push_back(center.y);
+  centerZ.push_back(center.z);
+  radius.push_back(sphereRadius);
+  return static_cast<uint32_t>(radius.size() - 1);
+}
+
+void LveFrustumCuller::cull() {
+  const uint32_t count = static_cast<uint32_t>(radius.size());
+  visible.clear();
+  stats.tested = count;
+
+  // Pad to a whole number of SIMD lanes; padded lanes are never reported
+  const uint32_t paddedCount = (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+  centerX.resize(paddedCount, 0.0f);
+  centerY.resize(paddedCount, 0.0f);
+  centerZ.resize(paddedCount, 0.0f);
+  radius.resize(paddedCount, 0.0f);
+
+  uint32_t i = 0;
+#if defined(LVE_CULL_AVX)
+  const __m256 zero = _mm256_setzero_ps();
+  for (; i < paddedCount; i += 8) {
+    const __m256 x = _mm256_loadu_ps(&centerX[i]);
+    const __m256 y = _mm256_loadu_ps(&centerY[i]);
+    const __m256 z = _mm256_loadu_ps(&centerZ[i]);
+    const __m256 r = _mm256_loadu_ps(&radius[i]);
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (const auto &plane : planes) {
+      __m256 distance = _mm256_add_ps(
+          _mm256_add_ps(
+              _mm256_mul_ps(x, _mm256_set1_ps(plane.x)),
+              _mm256_mul_ps(y, _mm256_set1_ps(plane.y))),
+          _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, r), zero, _CMP_GE_OQ));
+    }
+    int mask = _mm256_movemask_ps(inside);
+    for (uint32_t lane = 0; mask != 0; lane++, mask >>= 1) {
+      if ((mask & 1) && i + lane < count) visible.push_back(i + lane);
+    }
+  }
+#elif defined(LVE_CULL_SSE)
+  const __m128 zero = _mm_setzero_ps();
+  for (; i < paddedCount; i += 4) {
+    const __m128 x = _mm_loadu_ps(&centerX[i]);
+    const __m128 y = _mm_loadu_ps(&centerY[i]);
+    const __m128 z = _mm_loadu_ps(&centerZ[i]);
+    const __m128 r = _mm_loadu_ps(&radius[i]);
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (const auto &plane : planes) {
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+          _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), zero));
+    }
+    int mask = _mm_movemask_ps(inside);
+    for (uint32_t lane = 0; mask != 0; lane++, mask >>= 1) {
+      if ((mask & 1) && i + lane < count) visible.push_back(i + lane);
+    }
+  }
+#else
+  for (; i < count; i++) {
+    bool inside = true;
+    for (const auto &plane : planes) {
+      float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+      if (distance + radius[i] < 0.0f) {
+        inside = false;
+        break;
+      }
+    }
+    if (inside) visible.push_back(i);
+  }
+#endif
+
+  stats.culled = count - static_cast<uint32_t>(visible.size());
+}
+
+}  // namespace lve
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ve_model.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// Tests world-space bounding spheres against the six camera frustum planes. Spheres are stored as
+// structure-of-arrays so cull() can test 8 (AVX) or 4 (SSE) of them against a plane per
+// instruction; builds without either fall back to a scalar loop.
+class LveFrustumCuller {
+ public:
+  struct Stats {
+    uint32_t tested = 0;
+    uint32_t culled = 0;
+  };
+
+  // Number of spheres tested per SIMD instruction in this build
+  static const uint32_t SIMD_WIDTH;
+
+  // Clears the sphere list and sets the planes to test against (see LveCamera::getFrustumPlanes)
+  void begin(const std::array<glm::vec4, 6> &frustumPlanes);
+
+  // Adds a model's bounding sphere transformed by modelMatrix; returns its index in the list
+  uint32_t add(const LveModel &model, const glm::mat4 &modelMatrix);
+  uint32_t addSphere(const glm::vec3 &center, float radius);
+
+  // Fills the visible list with the indices of every sphere at least partially inside the frustum
+  void cull();
+
+  const std::vector<uint32_t> &getVisible() const { return visible; }
+  const Stats &getStats() const { return stats; }
+
+ private:
+  std::array<glm::vec4, 6> planes{};
+
+  std::vector<float> centerX;
+  std::vector<float> centerY;
+  std::vector<float> centerZ;
+  std::vector<float> radius;
+
+  std::vector<uint32_t> visible;
+  Stats stats{};
+};
+
+}  // namespace lve
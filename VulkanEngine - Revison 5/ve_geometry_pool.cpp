@@ -0,0 +1,252 @@
+#include "ve_geometry_pool.hpp"
+
+#include "ve_upload_manager.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+
+namespace lve {
+
+LveGeometryPool::LveGeometryPool(
+    LveDevice &device,
+    uint32_t vertexCapacity,
+    uint32_t indexCapacity,
+    LveModel::VertexFormat vertexFormat)
+    : lveDevice{device},
+      vertexFormat{vertexFormat},
+      vertexStride{LveModel::getVertexStride(vertexFormat)},
+      vertexCapacity{vertexCapacity},
+      indexCapacity{indexCapacity},
+      state{std::make_shared<FreeState>()} {
+  vertexBuffer = createVertexBuffer();
+  indexBuffer = createIndexBuffer();
+  state->vertices.release(0, vertexCapacity);
+  state->indices.release(0, indexCapacity);
+}
+
+LveGeometryPool::~LveGeometryPool() {}
+
+LveGeometryPool::Handle LveGeometryPool::allocate(
+    const void *vertexData, uint32_t newVertices, const std::vector<uint32_t> &indices) {
+  uint32_t newIndices = static_cast<uint32_t>(indices.size());
+  if (vertexCount + newVertices > vertexCapacity || indexCount + newIndices > indexCapacity) {
+    throw std::runtime_error("geometry pool is out of space!");
+  }
+
+  uint32_t vertexOffset = 0;
+  uint32_t firstIndex = 0;
+  auto tryAllocate = [&]() {
+    if (!state->vertices.allocate(newVertices, vertexOffset)) return false;
+    if (!state->indices.allocate(newIndices, firstIndex)) {
+      state->vertices.release(vertexOffset, newVertices);
+      return false;
+    }
+    return true;
+  };
+  // There is room in total (checked above), just not in one piece, or not until pending frees
+  // complete; compaction reclaims both
+  if (!tryAllocate()) {
+    compact();
+    if (!tryAllocate()) {
+      throw std::runtime_error("geometry pool is out of space!");
+    }
+  }
+
+  Handle handle;
+  if (!freeHandles.empty()) {
+    handle = freeHandles.back();
+    freeHandles.pop_back();
+  } else {
+    handle = static_cast<Handle>(slots.size());
+    slots.emplace_back();
+  }
+  Slot &slot = slots[handle];
+  slot.range.vertexOffset = static_cast<int32_t>(vertexOffset);
+  slot.range.vertexCount = newVertices;
+  slot.range.firstIndex = firstIndex;
+  slot.range.indexCount = newIndices;
+  slot.live = true;
+
+  // Copied with the next frame's upload batch
+  LveUploadManager &uploadManager = lveDevice.uploadManager();
+  uploadManager.upload(
+      vertexBuffer->getBuffer(),
+      static_cast<VkDeviceSize>(vertexStride) * vertexOffset,
+      vertexData,
+      static_cast<VkDeviceSize>(vertexStride) * newVertices);
+  uploadManager.upload(
+      indexBuffer->getBuffer(),
+      sizeof(uint32_t) * firstIndex,
+      indices.data(),
+      sizeof(uint32_t) * newIndices);
+
+  vertexCount += newVertices;
+  indexCount += newIndices;
+  return handle;
+}
+
+void LveGeometryPool::free(Handle handle) {
+  assert(handle < slots.size() && slots[handle].live && "Freeing an invalid geometry handle");
+  Slot &slot = slots[handle];
+  slot.live = false;
+  freeHandles.push_back(handle);
+  vertexCount -= slot.range.vertexCount;
+  indexCount -= slot.range.indexCount;
+
+  // Frames in flight may still draw from the range, so it only becomes reusable once they finish
+  std::shared_ptr<FreeState> freeState = state;
+  uint64_t generation = state->generation;
+  Range range = slot.range;
+  lveDevice.deletionQueue().push([freeState, generation, range]() {
+    if (freeState->generation != generation) return;
+    freeState->vertices.release(static_cast<uint32_t>(range.vertexOffset), range.vertexCount);
+    freeState->indices.release(range.firstIndex, range.indexCount);
+  });
+}
+
+void LveGeometryPool::compact() {
+  // Queued uploads into the old buffers have to land before they are copied out
+  lveDevice.uploadManager().waitIdle();
+
+  std::unique_ptr<LveBuffer> newVertexBuffer = createVertexBuffer();
+  std::unique_ptr<LveBuffer> newIndexBuffer = createIndexBuffer();
+
+  std::vector<VkBufferCopy> vertexCopies;
+  std::vector<VkBufferCopy> indexCopies;
+  uint32_t vertexEnd = 0;
+  uint32_t indexEnd = 0;
+  for (Slot &slot : slots) {
+    if (!slot.live) continue;
+    Range &range = slot.range;
+    if (range.vertexCount > 0) {
+      vertexCopies.push_back(
+          {static_cast<VkDeviceSize>(vertexStride) * static_cast<uint32_t>(range.vertexOffset),
+           static_cast<VkDeviceSize>(vertexStride) * vertexEnd,
+           static_cast<VkDeviceSize>(vertexStride) * range.vertexCount});
+    }
+    if (range.indexCount > 0) {
+      indexCopies.push_back(
+          {sizeof(uint32_t) * range.firstIndex,
+           sizeof(uint32_t) * indexEnd,
+           sizeof(uint32_t) * range.indexCount});
+    }
+    range.vertexOffset = static_cast<int32_t>(vertexEnd);
+    range.firstIndex = indexEnd;
+    vertexEnd += range.vertexCount;
+    indexEnd += range.indexCount;
+  }
+
+  VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
+  if (!vertexCopies.empty()) {
+    vkCmdCopyBuffer(
+        commandBuffer,
+        vertexBuffer->getBuffer(),
+        newVertexBuffer->getBuffer(),
+        static_cast<uint32_t>(vertexCopies.size()),
+        vertexCopies.data());
+  }
+  if (!indexCopies.empty()) {
+    vkCmdCopyBuffer(
+        commandBuffer,
+        indexBuffer->getBuffer(),
+        newIndexBuffer->getBuffer(),
+        static_cast<uint32_t>(indexCopies.size()),
+        indexCopies.data());
+  }
+  lveDevice.endSingleTimeCommands(commandBuffer);
+
+  // The old buffers' destructors defer their release past the frames still reading them
+  vertexBuffer = std::move(newVertexBuffer);
+  indexBuffer = std::move(newIndexBuffer);
+
+  state->generation++;
+  state->vertices.ranges.clear();
+  state->indices.ranges.clear();
+  state->vertices.release(vertexEnd, vertexCapacity - vertexEnd);
+  state->indices.release(indexEnd, indexCapacity - indexEnd);
+}
+
+void LveGeometryPool::bind(VkCommandBuffer commandBuffer) {
+  VkBuffer buffers[] = {vertexBuffer->getBuffer()};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, LveModel::VERTEX_BINDING, 1, buffers, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+}
+
+float LveGeometryPool::getFragmentation() const {
+  uint32_t freeIndices = 0;
+  for (const auto &range : state->indices.ranges) {
+    freeIndices += range.second;
+  }
+  if (freeIndices == 0) return 0.0f;
+  return 1.0f - static_cast<float>(state->indices.largest()) / static_cast<float>(freeIndices);
+}
+
+std::unique_ptr<LveBuffer> LveGeometryPool::createVertexBuffer() {
+  // Transfer source as well, for compaction
+  return std::make_unique<LveBuffer>(
+      lveDevice,
+      vertexStride,
+      vertexCapacity,
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+std::unique_ptr<LveBuffer> LveGeometryPool::createIndexBuffer() {
+  return std::make_unique<LveBuffer>(
+      lveDevice,
+      sizeof(uint32_t),
+      indexCapacity,
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+bool LveGeometryPool::FreeList::allocate(uint32_t count, uint32_t &offset) {
+  if (count == 0) {
+    offset = 0;
+    return true;
+  }
+  for (auto it = ranges.begin(); it != ranges.end(); ++it) {
+    if (it->second < count) continue;
+    offset = it->first;
+    uint32_t remaining = it->second - count;
+    ranges.erase(it);
+    if (remaining > 0) {
+      ranges.emplace(offset + count, remaining);
+    }
+    return true;
+  }
+  return false;
+}
+
+void LveGeometryPool::FreeList::release(uint32_t offset, uint32_t count) {
+  if (count == 0) return;
+  auto next = ranges.lower_bound(offset);
+  if (next != ranges.end() && offset + count == next->first) {
+    count += next->second;
+    next = ranges.erase(next);
+  }
+  if (next != ranges.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == offset) {
+      previous->second += count;
+      return;
+    }
+  }
+  ranges.emplace(offset, count);
+}
+
+uint32_t LveGeometryPool::FreeList::largest() const {
+  uint32_t size = 0;
+  for (const auto &range : ranges) {
+    size = std::max(size, range.second);
+  }
+  return size;
+}
+
+}  // namespace lve
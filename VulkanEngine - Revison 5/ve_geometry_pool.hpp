@@ -0,0 +1,115 @@
+#pragma once
+
+#include "ve_buffer.hpp"
+#include "ve_device.hpp"
+#include "ve_model.hpp"
+
+// std
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// Packs the vertex and index data of many meshes into one shared pair of device-local buffers.
+// All of a pool's meshes share one vertex format, so one pipeline vertex layout fits them all.
+// Every mesh is addressed by (vertexOffset, firstIndex, indexCount), so once the pool buffers are
+// bound a whole scene can be drawn without rebinding, which is what the indirect path needs.
+//
+// Meshes are allocated first fit from free lists and can be freed again; their space is reused
+// once the frames that may still draw them have completed. When free space is too fragmented for
+// an allocation, the pool compacts itself, which moves meshes, so look ranges up by handle rather
+// than keeping copies. Not thread-safe.
+class LveGeometryPool {
+ public:
+  static constexpr uint32_t DEFAULT_VERTEX_CAPACITY = 1 << 18;
+  static constexpr uint32_t DEFAULT_INDEX_CAPACITY = 1 << 20;
+
+  using Handle = uint32_t;
+  static constexpr Handle INVALID_HANDLE = UINT32_MAX;
+
+  struct Range {
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+  };
+
+  LveGeometryPool(
+      LveDevice &device,
+      uint32_t vertexCapacity = DEFAULT_VERTEX_CAPACITY,
+      uint32_t indexCapacity = DEFAULT_INDEX_CAPACITY,
+      LveModel::VertexFormat vertexFormat = LveModel::VertexFormat::FLOAT32);
+  ~LveGeometryPool();
+
+  LveGeometryPool(const LveGeometryPool &) = delete;
+  LveGeometryPool &operator=(const LveGeometryPool &) = delete;
+
+  // vertexData holds newVertices vertices already encoded in the pool's vertex format
+  Handle allocate(
+      const void *vertexData, uint32_t newVertices, const std::vector<uint32_t> &indices);
+  // The handle is invalid from now on; its space is reused once in-flight frames have completed
+  void free(Handle handle);
+  const Range &getRange(Handle handle) const { return slots[handle].range; }
+
+  // Copies every live mesh to the front of a fresh pair of buffers, leaving all free space in one
+  // piece at the end. Ranges move, and command buffers recorded earlier keep pointing at the old
+  // buffers (kept alive until in-flight frames complete), so anything replaying recorded draws
+  // must re-record once getGeneration() changes. Briefly needs twice the pool's memory.
+  void compact();
+  // Bumped by every compaction
+  uint64_t getGeneration() const { return state->generation; }
+
+  void bind(VkCommandBuffer commandBuffer);
+
+  LveModel::VertexFormat getVertexFormat() const { return vertexFormat; }
+
+  // Live data only; freed ranges no longer count
+  uint32_t getVertexCount() const { return vertexCount; }
+  uint32_t getIndexCount() const { return indexCount; }
+  // Share of free index space outside the largest free range: 0 when it is all in one piece
+  float getFragmentation() const;
+
+ private:
+  // Free ranges of one buffer, keyed by offset; neighbours are merged as they are released
+  struct FreeList {
+    std::map<uint32_t, uint32_t> ranges;
+
+    bool allocate(uint32_t count, uint32_t &offset);
+    void release(uint32_t offset, uint32_t count);
+    uint32_t largest() const;
+  };
+
+  // Shared with pending frees in the deletion queue, which can run after the pool is gone
+  struct FreeState {
+    FreeList vertices;
+    FreeList indices;
+    // Frees queued before a compaction refer to the old layout and are dropped
+    uint64_t generation = 0;
+  };
+
+  struct Slot {
+    Range range{};
+    bool live = false;
+  };
+
+  std::unique_ptr<LveBuffer> createVertexBuffer();
+  std::unique_ptr<LveBuffer> createIndexBuffer();
+
+  LveDevice &lveDevice;
+  std::unique_ptr<LveBuffer> vertexBuffer;
+  std::unique_ptr<LveBuffer> indexBuffer;
+
+  LveModel::VertexFormat vertexFormat;
+  uint32_t vertexStride;
+  uint32_t vertexCapacity;
+  uint32_t indexCapacity;
+  uint32_t vertexCount = 0;
+  uint32_t indexCount = 0;
+
+  std::shared_ptr<FreeState> state;
+  std::vector<Slot> slots;
+  std::vector<Handle> freeHandles;
+};
+
+}  // namespace lve
@@ -0,0 +1,226 @@
+#include "ve_gpu_profiler.hpp"
+
+// std
+#include <stdexcept>
+
+namespace lve {
+
+LveGpuProfiler::LveGpuProfiler(LveDevice &device, bool pipelineStatistics) : lveDevice{device} {
+  getStatsIndex("frame");
+
+  uint32_t validBits = lveDevice.graphicsTimestampValidBits();
+  if (validBits == 0) return;
+  timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+  nanosecondsPerTick = static_cast<double>(lveDevice.properties.limits.timestampPeriod);
+
+  VkQueryPoolCreateInfo timestampPoolInfo{};
+  timestampPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  timestampPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  timestampPoolInfo.queryCount = TIMESTAMPS_PER_FRAME * LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+  if (vkCreateQueryPool(lveDevice.device(), &timestampPoolInfo, nullptr, &timestampPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create timestamp query pool!");
+  }
+
+  if (!pipelineStatistics || !lveDevice.enabledFeatures.pipelineStatisticsQuery) return;
+
+  VkQueryPoolCreateInfo statisticsPoolInfo{};
+  statisticsPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  statisticsPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+  statisticsPoolInfo.queryCount = MAX_SCOPES_PER_FRAME * LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+  // Results come back in bit order: vertex, then fragment invocations
+  statisticsPoolInfo.pipelineStatistics =
+      VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+      VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+  if (vkCreateQueryPool(lveDevice.device(), &statisticsPoolInfo, nullptr, &statisticsPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline statistics query pool!");
+  }
+}
+
+LveGpuProfiler::~LveGpuProfiler() {
+  // Frames still in flight may write to the pools, so they are released once those complete
+  VkDevice device = lveDevice.device();
+  VkQueryPool retiredTimestampPool = timestampPool;
+  VkQueryPool retiredStatisticsPool = statisticsPool;
+  lveDevice.deletionQueue().push([device, retiredTimestampPool, retiredStatisticsPool]() {
+    if (retiredTimestampPool != VK_NULL_HANDLE) {
+      vkDestroyQueryPool(device, retiredTimestampPool, nullptr);
+    }
+    if (retiredStatisticsPool != VK_NULL_HANDLE) {
+      vkDestroyQueryPool(device, retiredStatisticsPool, nullptr);
+    }
+  });
+}
+
+void LveGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, int frameIndex) {
+  if (!isSupported()) return;
+
+  resolve(frameIndex);
+
+  auto &frame = frames[frameIndex];
+  frame.scopes.clear();
+  frame.statisticsQueryCount = 0;
+  frame.pending = true;
+  recordingFrame = frameIndex;
+  statisticsScope = INVALID_SCOPE;
+
+  vkCmdResetQueryPool(
+      commandBuffer,
+      timestampPool,
+      TIMESTAMPS_PER_FRAME * static_cast<uint32_t>(frameIndex),
+      TIMESTAMPS_PER_FRAME);
+  if (statisticsPool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(
+        commandBuffer,
+        statisticsPool,
+        MAX_SCOPES_PER_FRAME * static_cast<uint32_t>(frameIndex),
+        MAX_SCOPES_PER_FRAME);
+  }
+
+  frame.scopes.push_back(RecordedScope{0});
+  vkCmdWriteTimestamp(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      timestampPool,
+      TIMESTAMPS_PER_FRAME * static_cast<uint32_t>(frameIndex));
+}
+
+void LveGpuProfiler::endFrame(VkCommandBuffer commandBuffer) {
+  if (recordingFrame < 0) return;
+
+  vkCmdWriteTimestamp(
+      commandBuffer,
+      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      timestampPool,
+      TIMESTAMPS_PER_FRAME * static_cast<uint32_t>(recordingFrame) + 1);
+  recordingFrame = -1;
+}
+
+uint32_t LveGpuProfiler::beginScope(
+    VkCommandBuffer commandBuffer, const char *name, bool countInvocations) {
+  if (recordingFrame < 0) return INVALID_SCOPE;
+  auto &frame = frames[recordingFrame];
+  // The frame's own pair counts against the slot's timestamps
+  if (frame.scopes.size() > MAX_SCOPES_PER_FRAME) return INVALID_SCOPE;
+
+  uint32_t scope = static_cast<uint32_t>(frame.scopes.size());
+  RecordedScope recorded{getStatsIndex(name)};
+  if (countInvocations && statisticsPool != VK_NULL_HANDLE && statisticsScope == INVALID_SCOPE) {
+    recorded.statisticsQuery = frame.statisticsQueryCount++;
+    statisticsScope = scope;
+    vkCmdBeginQuery(
+        commandBuffer,
+        statisticsPool,
+        MAX_SCOPES_PER_FRAME * static_cast<uint32_t>(recordingFrame) + recorded.statisticsQuery,
+        0);
+  }
+  frame.scopes.push_back(recorded);
+
+  vkCmdWriteTimestamp(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      timestampPool,
+      TIMESTAMPS_PER_FRAME * static_cast<uint32_t>(recordingFrame) + 2 * scope);
+  return scope;
+}
+
+void LveGpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+  if (scope == INVALID_SCOPE || recordingFrame < 0) return;
+
+  vkCmdWriteTimestamp(
+      commandBuffer,
+      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      timestampPool,
+      TIMESTAMPS_PER_FRAME * static_cast<uint32_t>(recordingFrame) + 2 * scope + 1);
+  if (scope == statisticsScope) {
+    vkCmdEndQuery(
+        commandBuffer,
+        statisticsPool,
+        MAX_SCOPES_PER_FRAME * static_cast<uint32_t>(recordingFrame) +
+            frames[recordingFrame].scopes[scope].statisticsQuery);
+    statisticsScope = INVALID_SCOPE;
+  }
+}
+
+void LveGpuProfiler::resolve(int frameIndex) {
+  auto &frame = frames[frameIndex];
+  if (!frame.pending) return;
+  frame.pending = false;
+
+  // Without VK_QUERY_RESULT_WAIT_BIT this never blocks. The slot's fence has signaled, so the
+  // results are normally available; if they are not (the frame was never submitted), the frame
+  // is dropped rather than waited for.
+  uint32_t timestampCount = 2 * static_cast<uint32_t>(frame.scopes.size());
+  std::array<uint64_t, TIMESTAMPS_PER_FRAME> ticks{};
+  if (vkGetQueryPoolResults(
+          lveDevice.device(),
+          timestampPool,
+          TIMESTAMPS_PER_FRAME * static_cast<uint32_t>(frameIndex),
+          timestampCount,
+          timestampCount * sizeof(uint64_t),
+          ticks.data(),
+          sizeof(uint64_t),
+          VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+    return;
+  }
+
+  std::array<uint64_t, 2 * MAX_SCOPES_PER_FRAME> invocations{};
+  bool hasInvocations = false;
+  if (frame.statisticsQueryCount > 0) {
+    hasInvocations = vkGetQueryPoolResults(
+                         lveDevice.device(),
+                         statisticsPool,
+                         MAX_SCOPES_PER_FRAME * static_cast<uint32_t>(frameIndex),
+                         frame.statisticsQueryCount,
+                         2 * frame.statisticsQueryCount * sizeof(uint64_t),
+                         invocations.data(),
+                         2 * sizeof(uint64_t),
+                         VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+  }
+
+  for (size_t i = 0; i < frame.scopes.size(); i++) {
+    const auto &recorded = frame.scopes[i];
+    Sample sample{};
+    uint64_t elapsedTicks = (ticks[2 * i + 1] - ticks[2 * i]) & timestampMask;
+    sample.ms = static_cast<double>(elapsedTicks) * nanosecondsPerTick / 1.0e6;
+    if (hasInvocations && recorded.statisticsQuery != NO_QUERY) {
+      sample.vertexInvocations = invocations[2 * recorded.statisticsQuery];
+      sample.fragmentInvocations = invocations[2 * recorded.statisticsQuery + 1];
+    }
+    addSample(recorded.statsIndex, sample);
+  }
+}
+
+void LveGpuProfiler::addSample(uint32_t statsIndex, const Sample &sample) {
+  auto &history = histories[statsIndex];
+  history.samples[history.next] = sample;
+  history.next = (history.next + 1) % AVERAGE_WINDOW;
+  if (history.count < AVERAGE_WINDOW) history.count++;
+
+  // A scope opened several times in one frame contributes one sample per opening
+  Sample total{};
+  for (uint32_t i = 0; i < history.count; i++) {
+    total.ms += history.samples[i].ms;
+    total.vertexInvocations += history.samples[i].vertexInvocations;
+    total.fragmentInvocations += history.samples[i].fragmentInvocations;
+  }
+  auto &scopeStats = stats[statsIndex];
+  scopeStats.lastMs = sample.ms;
+  scopeStats.averageMs = total.ms / static_cast<double>(history.count);
+  scopeStats.vertexInvocations = total.vertexInvocations / history.count;
+  scopeStats.fragmentInvocations = total.fragmentInvocations / history.count;
+}
+
+uint32_t LveGpuProfiler::getStatsIndex(const char *name) {
+  auto it = statsIndices.find(name);
+  if (it != statsIndices.end()) return it->second;
+
+  uint32_t index = static_cast<uint32_t>(stats.size());
+  statsIndices.emplace(name, index);
+  stats.push_back(ScopeStats{name});
+  histories.emplace_back();
+  return index;
+}
+
+}  // namespace lve
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "ve_device.hpp"
+#include "ve_swap_chain.hpp"
+
+// std
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+// GPU time spent in named scopes (passes, draw batches) recorded into each frame's primary command
+// buffer, plus the whole frame. Every frame slot has its own range of timestamp queries, read back
+// when the slot comes round again: its fence has been waited on by then, so the results are ready
+// without stalling, one slot cycle late (frame N-2 with two frames in flight). Optionally, scopes
+// that are not nested inside another counting scope also count vertex and fragment shader
+// invocations with a pipeline statistics query.
+class LveGpuProfiler {
+ public:
+  static constexpr uint32_t MAX_SCOPES_PER_FRAME = 32;
+  // Number of resolved frames the averages are taken over
+  static constexpr uint32_t AVERAGE_WINDOW = 64;
+  static constexpr uint32_t INVALID_SCOPE = UINT32_MAX;
+
+  struct ScopeStats {
+    std::string name;
+    double lastMs = 0.0;
+    double averageMs = 0.0;
+    // Averaged over the same window; 0 unless the scope had a pipeline statistics query
+    uint64_t vertexInvocations = 0;
+    uint64_t fragmentInvocations = 0;
+  };
+
+  // Opens a scope for its own lifetime
+  class Scope {
+   public:
+    Scope(LveGpuProfiler &profiler, VkCommandBuffer commandBuffer, const char *name)
+        : profiler{profiler},
+          commandBuffer{commandBuffer},
+          scope{profiler.beginScope(commandBuffer, name)} {}
+    ~Scope() { profiler.endScope(commandBuffer, scope); }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+   private:
+    LveGpuProfiler &profiler;
+    VkCommandBuffer commandBuffer;
+    uint32_t scope;
+  };
+
+  // Pipeline statistics are collected only when asked for and the device enabled the
+  // pipelineStatisticsQuery feature
+  LveGpuProfiler(LveDevice &device, bool pipelineStatistics = false);
+  ~LveGpuProfiler();
+
+  LveGpuProfiler(const LveGpuProfiler &) = delete;
+  LveGpuProfiler &operator=(const LveGpuProfiler &) = delete;
+
+  // False when the graphics queue cannot write timestamps; every other call is then a no-op
+  bool isSupported() const { return timestampPool != VK_NULL_HANDLE; }
+  bool hasPipelineStatistics() const { return statisticsPool != VK_NULL_HANDLE; }
+
+  // Resolves what frameIndex recorded last time round, then resets its queries and starts timing
+  // the frame. Call right after vkBeginCommandBuffer, outside a render pass, once the slot's fence
+  // has been waited on.
+  void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+  // Stops timing the frame; call just before vkEndCommandBuffer
+  void endFrame(VkCommandBuffer commandBuffer);
+
+  // Scopes may nest, but must end in the render pass (and subpass) they began in. Inside a render
+  // pass the subpass contents must be VK_SUBPASS_CONTENTS_INLINE. Returns INVALID_SCOPE, which
+  // endScope ignores, when profiling is unsupported or the frame has run out of scopes.
+  // Pass countInvocations = false for a scope that executes secondary command buffers: a
+  // pipeline statistics query cannot stay active across vkCmdExecuteCommands unless the
+  // secondaries inherit it.
+  uint32_t beginScope(
+      VkCommandBuffer commandBuffer, const char *name, bool countInvocations = true);
+  void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+  // The whole frame first, then one entry per scope name in the order first opened
+  const std::vector<ScopeStats> &getStats() const { return stats; }
+
+ private:
+  // Timestamps per slot: the frame's pair, then a pair per scope
+  static constexpr uint32_t TIMESTAMPS_PER_FRAME = 2 * (MAX_SCOPES_PER_FRAME + 1);
+  static constexpr uint32_t NO_QUERY = UINT32_MAX;
+
+  struct RecordedScope {
+    uint32_t statsIndex;
+    uint32_t statisticsQuery = NO_QUERY;
+  };
+
+  struct FrameQueries {
+    // Index 0 is the frame itself
+    std::vector<RecordedScope> scopes;
+    uint32_t statisticsQueryCount = 0;
+    bool pending = false;
+  };
+
+  struct Sample {
+    double ms = 0.0;
+    uint64_t vertexInvocations = 0;
+    uint64_t fragmentInvocations = 0;
+  };
+
+  struct History {
+    std::array<Sample, AVERAGE_WINDOW> samples{};
+    uint32_t count = 0;
+    uint32_t next = 0;
+  };
+
+  void resolve(int frameIndex);
+  void addSample(uint32_t statsIndex, const Sample &sample);
+  uint32_t getStatsIndex(const char *name);
+
+  LveDevice &lveDevice;
+  VkQueryPool timestampPool = VK_NULL_HANDLE;
+  VkQueryPool statisticsPool = VK_NULL_HANDLE;
+  // Ticks are only meaningful in the low timestampValidBits bits
+  uint64_t timestampMask = 0;
+  double nanosecondsPerTick = 1.0;
+
+  std::array<FrameQueries, LveSwapChain::MAX_FRAMES_IN_FLIGHT> frames{};
+  // Slot being recorded, or -1 between endFrame and beginFrame
+  int recordingFrame = -1;
+  // Scope holding the active pipeline statistics query, which cannot nest
+  uint32_t statisticsScope = INVALID_SCOPE;
+
+  std::vector<ScopeStats> stats;
+  std::vector<History> histories;
+  std::unordered_map<std::string, uint32_t> statsIndices;
+};
+
+}  // namespace lve
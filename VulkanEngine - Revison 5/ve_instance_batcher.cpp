@@ -0,0 +1,331 @@
+#include "ve_instance_batcher.hpp"
+
+#include "ve_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+LveInstanceBatcher::LveInstanceBatcher(LveDevice &device, uint32_t initialCapacity)
+    : lveDevice{device} {
+  instanceBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  indirectBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  bufferLayoutGenerations.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+  pendingWrites.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  for (int i = 0; i < LveSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+    ensureCapacity(i, initialCapacity);
+    ensureIndirectCapacity(i, 16);
+  }
+}
+
+void LveInstanceBatcher::begin() {
+  pendingInstances.clear();
+  renderQueue.clear();
+}
+
+void LveInstanceBatcher::add(
+    LveModel *model, const glm::mat4 &modelMatrix, const glm::vec3 &color, vePipeline *pipeline) {
+  add(model, pipeline, modelMatrix, color, ANONYMOUS_INSTANCE, 0);
+}
+
+void LveInstanceBatcher::add(LveGameObject &gameObject, vePipeline *pipeline) {
+  if (gameObject.model == nullptr) return;
+  // mat4() bumps the version when it rebuilds the cached matrix, so read the version after it
+  const glm::mat4 &modelMatrix = gameObject.transform.mat4();
+  uint32_t version = gameObject.transform.getVersion();
+  add(gameObject.model.get(),
+      pipeline,
+      modelMatrix,
+      gameObject.color,
+      static_cast<uint64_t>(gameObject.getId()) + 1,
+      version);
+}
+
+void LveInstanceBatcher::addAll(LveGameObject::Map &gameObjects, vePipeline *pipeline) {
+  for (auto &kv : gameObjects) {
+    add(kv.second, pipeline);
+  }
+}
+
+void LveInstanceBatcher::add(
+    LveModel *model,
+    vePipeline *pipeline,
+    const glm::mat4 &modelMatrix,
+    const glm::vec3 &color,
+    uint64_t objectKey,
+    uint32_t transformVersion) {
+  if (model == nullptr) return;
+
+  // No depth bucket: sorting instances front to back would move them between slots as the camera
+  // turns and force a full upload every frame, for little gain inside a single instanced draw
+  uint32_t pipelineId = pipeline != nullptr ? pipeline->getId() : 0;
+  renderQueue.push(
+      LveRenderQueue::makeKey(pipelineId, model->getId(), 0),
+      static_cast<uint32_t>(pendingInstances.size()));
+
+  PendingInstance instance{};
+  instance.model = model;
+  instance.pipeline = pipeline;
+  instance.objectKey = objectKey;
+  instance.transformVersion = transformVersion;
+  // Quantized positions are decoded by the instance matrix, which costs the shader nothing and
+  // needs no per-draw state, so indirect batches keep working
+  instance.data.modelMatrix = model->getVertexFormat() == LveModel::VertexFormat::QUANTIZED
+                                  ? modelMatrix * model->getDequantization()
+                                  : modelMatrix;
+  instance.data.color = glm::vec4(color, 1.0f);
+  pendingInstances.push_back(instance);
+}
+
+void LveInstanceBatcher::upload(int frameIndex) {
+  assert(frameIndex >= 0 && frameIndex < LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+  // Sorted order is slot order: consecutive packets with the same pipeline and model form a batch
+  renderQueue.sort();
+  const auto &packets = renderQueue.getPackets();
+  uint32_t instanceCount = static_cast<uint32_t>(packets.size());
+
+  batches.clear();
+  for (uint32_t slot = 0; slot < instanceCount; slot++) {
+    const PendingInstance &pending = pendingInstances[packets[slot].index];
+    if (batches.empty() || batches.back().model != pending.model ||
+        batches.back().pipeline != pending.pipeline) {
+      batches.push_back({pending.model, pending.pipeline, slot, 0});
+    }
+    batches.back().instanceCount++;
+  }
+
+  // The layout is unchanged when the same objects land in the same slots of the same batches as
+  // last frame. Only then can a slot be skipped when its transform and color haven't changed.
+  bool sameLayout = instanceCount == instanceKeys.size() && batches.size() == previousBatches.size();
+  for (size_t i = 0; sameLayout && i < batches.size(); i++) {
+    sameLayout = batches[i].model == previousBatches[i].model &&
+                 batches[i].pipeline == previousBatches[i].pipeline &&
+                 batches[i].instanceCount == previousBatches[i].instanceCount;
+  }
+  previousBatches = batches;
+
+  if (!sameLayout) {
+    instanceKeys.assign(instanceCount, ANONYMOUS_INSTANCE);
+    instanceVersions.assign(instanceCount, 0);
+    instanceMirror.resize(instanceCount);
+  }
+
+  changedInstances.clear();
+  for (uint32_t slot = 0; slot < instanceCount; slot++) {
+    const PendingInstance &pending = pendingInstances[packets[slot].index];
+    bool changed = pending.objectKey == ANONYMOUS_INSTANCE ||
+                   instanceKeys[slot] != pending.objectKey ||
+                   instanceVersions[slot] != pending.transformVersion ||
+                   instanceMirror[slot].color != pending.data.color;
+    if (!changed) continue;
+
+    if (instanceKeys[slot] != pending.objectKey) {
+      sameLayout = false;
+    }
+    instanceKeys[slot] = pending.objectKey;
+    instanceVersions[slot] = pending.transformVersion;
+    instanceMirror[slot] = pending.data;
+    changedInstances.push_back(slot);
+  }
+
+  if (!sameLayout) {
+    // Every buffer now holds a stale layout and needs a full copy on its next upload
+    layoutGeneration++;
+    for (auto &writes : pendingWrites) {
+      writes.clear();
+    }
+  } else {
+    // A change has to reach every frame's buffer, not just the one being written now
+    for (int i = 0; i < LveSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+      if (bufferLayoutGenerations[i] != layoutGeneration) continue;
+      pendingWrites[i].insert(
+          pendingWrites[i].end(), changedInstances.begin(), changedInstances.end());
+      // A slot left unused by a lower frames-in-flight setting would queue writes forever;
+      // once its backlog outgrows a full copy, fall back to one
+      if (pendingWrites[i].size() > instanceCount) {
+        pendingWrites[i].clear();
+        bufferLayoutGenerations[i] = 0;
+      }
+    }
+  }
+
+  if (instanceCount == 0) return;
+
+  if (ensureCapacity(frameIndex, instanceCount)) {
+    bufferLayoutGenerations[frameIndex] = 0;
+  }
+
+  auto *instances =
+      static_cast<LveModel::InstanceData *>(instanceBuffers[frameIndex]->getMappedMemory());
+  if (bufferLayoutGenerations[frameIndex] != layoutGeneration) {
+    std::copy(instanceMirror.begin(), instanceMirror.end(), instances);
+    bufferLayoutGenerations[frameIndex] = layoutGeneration;
+  } else {
+    for (uint32_t slot : pendingWrites[frameIndex]) {
+      instances[slot] = instanceMirror[slot];
+    }
+  }
+  pendingWrites[frameIndex].clear();
+}
+
+void LveInstanceBatcher::draw(VkCommandBuffer commandBuffer, int frameIndex) {
+  drawRange(commandBuffer, frameIndex, 0, static_cast<uint32_t>(batches.size()));
+}
+
+void LveInstanceBatcher::drawRange(
+    VkCommandBuffer commandBuffer, int frameIndex, uint32_t firstBatch, uint32_t batchCount) const {
+  if (batchCount == 0) return;
+  assert(firstBatch + batchCount <= batches.size());
+
+  bindInstanceBuffer(commandBuffer, frameIndex);
+
+  // Batches arrive sorted by pipeline then model, so most of these binds are skipped
+  vePipeline *boundPipeline = nullptr;
+  LveModel *boundModel = nullptr;
+  LveGeometryPool *boundPool = nullptr;
+  for (uint32_t i = firstBatch; i < firstBatch + batchCount; i++) {
+    const Batch &batch = batches[i];
+    if (batch.pipeline != nullptr && batch.pipeline != boundPipeline) {
+      batch.pipeline->bind(commandBuffer);
+      boundPipeline = batch.pipeline;
+    }
+
+    // Pooled models share the pool's buffers, so moving between them binds nothing
+    if (batch.model != boundModel) {
+      batch.model->bind(commandBuffer, boundPool);
+      boundModel = batch.model;
+    }
+
+    batch.model->draw(commandBuffer, batch.instanceCount, batch.firstInstance);
+  }
+}
+
+void LveInstanceBatcher::drawIndirect(
+    VkCommandBuffer commandBuffer, int frameIndex, LveGeometryPool &geometryPool) {
+  if (batches.empty()) return;
+
+  // Without drawIndirectFirstInstance every indirect command must start at instance 0, which
+  // doesn't work with one shared instance buffer
+  if (!lveDevice.enabledFeatures.drawIndirectFirstInstance) {
+    draw(commandBuffer, frameIndex);
+    return;
+  }
+
+  bindInstanceBuffer(commandBuffer, frameIndex);
+
+  ensureIndirectCapacity(frameIndex, static_cast<uint32_t>(batches.size()));
+  auto *commands = static_cast<VkDrawIndexedIndirectCommand *>(
+      indirectBuffers[frameIndex]->getMappedMemory());
+
+  vePipeline *boundPipeline = nullptr;
+  LveGeometryPool *boundPool = nullptr;
+  uint32_t drawCount = 0;
+  size_t i = 0;
+  while (i < batches.size()) {
+    vePipeline *pipeline = batches[i].pipeline;
+    if (pipeline != nullptr && pipeline != boundPipeline) {
+      pipeline->bind(commandBuffer);
+      boundPipeline = pipeline;
+    }
+
+    // Models that own their buffers still need a bind per batch
+    if (batches[i].model->getGeometryPool() != &geometryPool) {
+      batches[i].model->bind(commandBuffer, boundPool);
+      batches[i].model->draw(commandBuffer, batches[i].instanceCount, batches[i].firstInstance);
+      i++;
+      continue;
+    }
+
+    // Every following pooled batch on the same pipeline goes into one indirect submission
+    uint32_t firstCommand = drawCount;
+    while (i < batches.size() && batches[i].pipeline == pipeline &&
+           batches[i].model->getGeometryPool() == &geometryPool) {
+      const Batch &batch = batches[i++];
+      VkDrawIndexedIndirectCommand &command = commands[drawCount++];
+      command.indexCount = batch.model->getIndexCount();
+      command.instanceCount = batch.instanceCount;
+      command.firstIndex = batch.model->getFirstIndex();
+      command.vertexOffset = batch.model->getVertexOffset();
+      command.firstInstance = batch.firstInstance;
+    }
+
+    if (boundPool != &geometryPool) {
+      geometryPool.bind(commandBuffer);
+      boundPool = &geometryPool;
+    }
+    submitIndirect(commandBuffer, frameIndex, firstCommand, drawCount - firstCommand);
+  }
+}
+
+void LveInstanceBatcher::submitIndirect(
+    VkCommandBuffer commandBuffer, int frameIndex, uint32_t firstCommand, uint32_t commandCount) {
+  VkBuffer indirectBuffer = indirectBuffers[frameIndex]->getBuffer();
+  const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  if (lveDevice.enabledFeatures.multiDrawIndirect) {
+    uint32_t maxDrawCount = lveDevice.properties.limits.maxDrawIndirectCount;
+    for (uint32_t first = 0; first < commandCount; first += maxDrawCount) {
+      uint32_t count = std::min(maxDrawCount, commandCount - first);
+      vkCmdDrawIndexedIndirect(
+          commandBuffer, indirectBuffer, (firstCommand + first) * stride, count, stride);
+    }
+  } else {
+    for (uint32_t i = 0; i < commandCount; i++) {
+      vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, (firstCommand + i) * stride, 1, stride);
+    }
+  }
+}
+
+void LveInstanceBatcher::bindInstanceBuffer(VkCommandBuffer commandBuffer, int frameIndex) const {
+  VkBuffer buffers[] = {instanceBuffers[frameIndex]->getBuffer()};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, LveModel::INSTANCE_BINDING, 1, buffers, offsets);
+}
+
+bool LveInstanceBatcher::ensureCapacity(int frameIndex, uint32_t instanceCount) {
+  auto &buffer = instanceBuffers[frameIndex];
+  if (buffer != nullptr && buffer->getInstanceCount() >= instanceCount) return false;
+
+  // Grow geometrically so a steadily increasing object count doesn't reallocate every frame
+  uint32_t capacity = buffer != nullptr ? buffer->getInstanceCount() : 1;
+  while (capacity < instanceCount) {
+    capacity *= 2;
+  }
+
+  // The previous buffer for this slot is idle: its frame fence was waited on before recording
+  buffer = std::make_unique<LveBuffer>(
+      lveDevice,
+      sizeof(LveModel::InstanceData),
+      capacity,
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  if (buffer->map() != VK_SUCCESS) {
+    throw std::runtime_error("failed to map instance buffer!");
+  }
+  return true;
+}
+
+void LveInstanceBatcher::ensureIndirectCapacity(int frameIndex, uint32_t drawCount) {
+  auto &buffer = indirectBuffers[frameIndex];
+  if (buffer != nullptr && buffer->getInstanceCount() >= drawCount) return;
+
+  uint32_t capacity = buffer != nullptr ? buffer->getInstanceCount() : 1;
+  while (capacity < drawCount) {
+    capacity *= 2;
+  }
+
+  buffer = std::make_unique<LveBuffer>(
+      lveDevice,
+      sizeof(VkDrawIndexedIndirectCommand),
+      capacity,
+      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  if (buffer->map() != VK_SUCCESS) {
+    throw std::runtime_error("failed to map indirect buffer!");
+  }
+}
+
+}  // namespace lve
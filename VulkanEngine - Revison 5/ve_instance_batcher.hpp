@@ -0,0 +1,120 @@
+#pragma once
+
+#include "ve_buffer.hpp"
+#include "ve_device.hpp"
+#include "ve_game_object.hpp"
+#include "ve_geometry_pool.hpp"
+#include "ve_model.hpp"
+#include "ve_pipeline.hpp"
+#include "ve_render_queue.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// Groups objects that share an LveModel into a single instanced draw. Per-instance transform and
+// color are written into a persistently mapped buffer (one per frame in flight) that is bound at
+// LveModel::INSTANCE_BINDING, so the cost of submitting a model is one bind and one draw no
+// matter how many objects use it. Instances are ordered through an LveRenderQueue keyed by
+// (pipeline, model), which makes batches come out sorted by pipeline and model. The key leaves the
+// depth field empty: the sort is stable, so instances keep the order they were added in and stay
+// in the same slots from frame to frame, which is what lets upload() skip unchanged ones.
+class LveInstanceBatcher {
+ public:
+  struct Batch {
+    LveModel *model;
+    // Bound before the batch is drawn; nullptr draws with whatever pipeline is already bound
+    vePipeline *pipeline;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+  };
+
+  LveInstanceBatcher(LveDevice &device, uint32_t initialCapacity = 256);
+
+  LveInstanceBatcher(const LveInstanceBatcher &) = delete;
+  LveInstanceBatcher &operator=(const LveInstanceBatcher &) = delete;
+
+  // Collection: call begin(), add every visible object, then upload() once per frame
+  void begin();
+  void add(
+      LveModel *model,
+      const glm::mat4 &modelMatrix,
+      const glm::vec3 &color,
+      vePipeline *pipeline = nullptr);
+  void add(LveGameObject &gameObject, vePipeline *pipeline = nullptr);
+  void addAll(LveGameObject::Map &gameObjects, vePipeline *pipeline = nullptr);
+
+  // Sorts the collected instances into batches and writes them into the frame's instance buffer.
+  // The buffer for frameIndex must no longer be in use by the GPU. While the same objects are
+  // submitted in the same order, only instances whose transform or color changed are rewritten.
+  void upload(int frameIndex);
+
+  // Binds the frame's instance buffer and issues one instanced draw per batch, skipping pipeline
+  // and vertex/index binds that match the previous batch
+  void draw(VkCommandBuffer commandBuffer, int frameIndex);
+  // Same as draw() for batches [firstBatch, firstBatch + batchCount) only. Only reads batcher
+  // state, so disjoint ranges can be recorded into different command buffers concurrently.
+  void drawRange(
+      VkCommandBuffer commandBuffer, int frameIndex, uint32_t firstBatch, uint32_t batchCount) const;
+
+  // Writes one VkDrawIndexedIndirectCommand per batch whose model lives in geometryPool into the
+  // frame's indirect buffer, binds the pool once and submits each pipeline's run of commands with
+  // a single vkCmdDrawIndexedIndirect. Batches outside the pool fall back to the per-model path,
+  // and so does everything when the device lacks drawIndirectFirstInstance.
+  void drawIndirect(VkCommandBuffer commandBuffer, int frameIndex, LveGeometryPool &geometryPool);
+
+  const std::vector<Batch> &getBatches() const { return batches; }
+  uint32_t getInstanceCount() const { return static_cast<uint32_t>(pendingInstances.size()); }
+  // Instance slots whose data changed in the last upload()
+  const std::vector<uint32_t> &getChangedInstances() const { return changedInstances; }
+
+ private:
+  // Instances added without a game object can't be tracked and are rewritten every frame
+  static constexpr uint64_t ANONYMOUS_INSTANCE = 0;
+
+  struct PendingInstance {
+    LveModel *model;
+    vePipeline *pipeline;
+    uint64_t objectKey;
+    uint32_t transformVersion;
+    LveModel::InstanceData data;
+  };
+
+  void add(
+      LveModel *model,
+      vePipeline *pipeline,
+      const glm::mat4 &modelMatrix,
+      const glm::vec3 &color,
+      uint64_t objectKey,
+      uint32_t transformVersion);
+  void submitIndirect(
+      VkCommandBuffer commandBuffer, int frameIndex, uint32_t firstCommand, uint32_t commandCount);
+  void bindInstanceBuffer(VkCommandBuffer commandBuffer, int frameIndex) const;
+  // Returns true if the buffer was reallocated (and so lost its contents)
+  bool ensureCapacity(int frameIndex, uint32_t instanceCount);
+  void ensureIndirectCapacity(int frameIndex, uint32_t drawCount);
+
+  LveDevice &lveDevice;
+  std::vector<std::unique_ptr<LveBuffer>> instanceBuffers;
+  std::vector<std::unique_ptr<LveBuffer>> indirectBuffers;
+
+  std::vector<PendingInstance> pendingInstances;
+  LveRenderQueue renderQueue;
+  std::vector<Batch> batches;
+
+  // Last uploaded state of every instance slot, used to detect what changed between frames
+  std::vector<Batch> previousBatches;
+  std::vector<uint64_t> instanceKeys;
+  std::vector<uint32_t> instanceVersions;
+  std::vector<LveModel::InstanceData> instanceMirror;
+  std::vector<uint32_t> changedInstances;
+
+  // Each frame's buffer remembers which layout it holds and which slots it still has to catch up on
+  uint64_t layoutGeneration = 1;
+  std::vector<uint64_t> bufferLayoutGenerations;
+  std::vector<std::vector<uint32_t>> pendingWrites;
+};
+
+}  // namespace lve
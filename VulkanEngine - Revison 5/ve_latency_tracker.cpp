@@ -0,0 +1,56 @@
+#include "ve_latency_tracker.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+namespace lve {
+
+void LveLatencyTracker::frameCompleted(int frameIndex) {
+  assert(frameIndex >= 0 && frameIndex < LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+  TrackedFrame &frame = trackedFrames[frameIndex];
+  if (!frame.active) return;
+  frame.active = false;
+
+  double latencyMs = millisecondsSince(frame.inputTime, Clock::now());
+  // Running average, so takeStats has nothing left to divide
+  stats.completedFrames++;
+  stats.averageCompleteMs += (latencyMs - stats.averageCompleteMs) / stats.completedFrames;
+  stats.maxCompleteMs = std::max(stats.maxCompleteMs, latencyMs);
+}
+
+void LveLatencyTracker::frameStarted(int frameIndex, Clock::time_point inputTime) {
+  assert(frameIndex >= 0 && frameIndex < LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+  TrackedFrame &frame = trackedFrames[frameIndex];
+  frame.active = inputTime > lastInputTime;
+  if (!frame.active) return;
+
+  frame.inputTime = inputTime;
+  lastInputTime = inputTime;
+}
+
+void LveLatencyTracker::framePresented(int frameIndex) {
+  assert(frameIndex >= 0 && frameIndex < LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+  const TrackedFrame &frame = trackedFrames[frameIndex];
+  if (!frame.active) return;
+
+  double latencyMs = millisecondsSince(frame.inputTime, Clock::now());
+  stats.presentedFrames++;
+  stats.averagePresentMs += (latencyMs - stats.averagePresentMs) / stats.presentedFrames;
+  stats.maxPresentMs = std::max(stats.maxPresentMs, latencyMs);
+}
+
+LveLatencyTracker::Stats LveLatencyTracker::takeStats() {
+  Stats result = stats;
+  stats = Stats{};
+  return result;
+}
+
+double LveLatencyTracker::millisecondsSince(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+}  // namespace lve
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ve_swap_chain.hpp"
+
+// std
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace lve {
+
+// Measures how long sampled input takes to reach the display. Each frame carries the time its
+// input was sampled. The latency to the present call is known when vkQueuePresentKHR returns. The
+// latency to GPU completion is known when the frame slot's fence is next waited on, which makes it
+// an upper bound. Scan-out after that point cannot be observed without present-timing extensions.
+class LveLatencyTracker {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Stats {
+    uint32_t presentedFrames = 0;
+    double averagePresentMs = 0.0;
+    double maxPresentMs = 0.0;
+    uint32_t completedFrames = 0;
+    double averageCompleteMs = 0.0;
+    double maxCompleteMs = 0.0;
+  };
+
+  // frameIndex's fence has just been waited on, so the frame last recorded there is complete
+  void frameCompleted(int frameIndex);
+  // Starts tracking the frame about to be recorded into frameIndex. Frames whose input is no newer
+  // than the previous tracked frame's (no fresh input was sampled) are skipped.
+  void frameStarted(int frameIndex, Clock::time_point inputTime);
+  // vkQueuePresentKHR has returned for the frame recorded into frameIndex
+  void framePresented(int frameIndex);
+
+  // Stats gathered since the last call
+  Stats takeStats();
+
+ private:
+  struct TrackedFrame {
+    Clock::time_point inputTime{};
+    bool active = false;
+  };
+
+  static double millisecondsSince(Clock::time_point start, Clock::time_point end);
+
+  std::array<TrackedFrame, LveSwapChain::MAX_FRAMES_IN_FLIGHT> trackedFrames{};
+  Clock::time_point lastInputTime{};
+  Stats stats{};
+};
+
+}  // namespace lve
@@ -0,0 +1,511 @@
+#include "ve_memory_allocator.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+uint32_t mostSignificantBit(uint64_t value) {
+  uint32_t bit = 0;
+  while (value >>= 1) {
+    bit++;
+  }
+  return bit;
+}
+
+uint32_t leastSignificantBit(uint64_t value) {
+  uint32_t bit = 0;
+  while ((value & 1) == 0) {
+    value >>= 1;
+    bit++;
+  }
+  return bit;
+}
+
+}  // namespace
+
+// One VkDeviceMemory managed as a TLSF heap. Offsets and sizes are kept in GRANULARITY units.
+// Free ranges sit in a list per (first level, second level) size class: the first level is the
+// power of two below the size, the second splits that range into SL_COUNT equal classes. The
+// bitmaps record which lists are non-empty, so a good fit is found with two bit scans.
+class LveMemoryBlock {
+ public:
+  static constexpr VkDeviceSize GRANULARITY = 256;
+
+  LveMemoryBlock(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryType, void *mapped)
+      : memory{memory}, size{size}, memoryType{memoryType}, mapped{mapped} {
+    for (auto &heads : freeHeads) {
+      heads.fill(NONE);
+    }
+    uint32_t whole = newChunk();
+    chunks[whole].offset = 0;
+    chunks[whole].units = size / GRANULARITY;
+    insertFree(whole);
+  }
+
+  // Returns false when no free range fits
+  bool allocate(VkDeviceSize requestSize, VkDeviceSize alignment, LveAllocation &allocation) {
+    alignment = std::max(alignment, GRANULARITY);
+    uint64_t units = alignUp(requestSize, GRANULARITY) / GRANULARITY;
+    // Enough slack that any fitting range can be aligned by splitting off its front
+    uint64_t searchUnits = units + (alignment - GRANULARITY) / GRANULARITY;
+
+    uint32_t index = findFree(searchUnits);
+    if (index == NONE) return false;
+    removeFree(index);
+
+    uint64_t alignedOffset = alignUp(chunks[index].offset * GRANULARITY, alignment) / GRANULARITY;
+    uint64_t padding = alignedOffset - chunks[index].offset;
+    if (padding > 0) {
+      // The range before a free one is always in use, so the padding stays a separate range
+      uint32_t front = newChunk();
+      chunks[front].offset = chunks[index].offset;
+      chunks[front].units = padding;
+      chunks[front].prevPhysical = chunks[index].prevPhysical;
+      chunks[front].nextPhysical = index;
+      if (chunks[front].prevPhysical != NONE) {
+        chunks[chunks[front].prevPhysical].nextPhysical = front;
+      }
+      chunks[index].prevPhysical = front;
+      chunks[index].offset += padding;
+      chunks[index].units -= padding;
+      insertFree(front);
+    }
+    if (chunks[index].units > units) {
+      uint32_t back = newChunk();
+      chunks[back].offset = chunks[index].offset + units;
+      chunks[back].units = chunks[index].units - units;
+      chunks[back].prevPhysical = index;
+      chunks[back].nextPhysical = chunks[index].nextPhysical;
+      if (chunks[back].nextPhysical != NONE) {
+        chunks[chunks[back].nextPhysical].prevPhysical = back;
+      }
+      chunks[index].nextPhysical = back;
+      chunks[index].units = units;
+      insertFree(back);
+    }
+
+    chunks[index].free = false;
+    usedUnits += chunks[index].units;
+    allocationCount++;
+
+    allocation.memory = memory;
+    allocation.offset = chunks[index].offset * GRANULARITY;
+    allocation.size = requestSize;
+    allocation.mapped = mapped != nullptr ? static_cast<char *>(mapped) + allocation.offset
+                                          : nullptr;
+    allocation.block = this;
+    allocation.chunk = index;
+    allocation.memoryType = memoryType;
+    return true;
+  }
+
+  void free(uint32_t index) {
+    usedUnits -= chunks[index].units;
+    allocationCount--;
+    chunks[index].free = true;
+
+    uint32_t prev = chunks[index].prevPhysical;
+    if (prev != NONE && chunks[prev].free) {
+      removeFree(prev);
+      chunks[index].offset = chunks[prev].offset;
+      chunks[index].units += chunks[prev].units;
+      unlinkPhysical(prev);
+    }
+    uint32_t next = chunks[index].nextPhysical;
+    if (next != NONE && chunks[next].free) {
+      removeFree(next);
+      chunks[index].units += chunks[next].units;
+      unlinkPhysical(next);
+    }
+    insertFree(index);
+  }
+
+  bool isEmpty() const { return allocationCount == 0; }
+
+  const VkDeviceMemory memory;
+  const VkDeviceSize size;
+  const uint32_t memoryType;
+  void *const mapped;
+  uint64_t usedUnits = 0;
+  uint32_t allocationCount = 0;
+
+ private:
+  static constexpr uint32_t NONE = UINT32_MAX;
+  static constexpr uint32_t SL_LOG2 = 4;
+  static constexpr uint32_t SL_COUNT = 1u << SL_LOG2;
+  static constexpr uint32_t FL_COUNT = 64;
+
+  struct Chunk {
+    uint64_t offset = 0;
+    uint64_t units = 0;
+    uint32_t prevPhysical = NONE;
+    uint32_t nextPhysical = NONE;
+    uint32_t prevFree = NONE;
+    uint32_t nextFree = NONE;
+    bool free = true;
+  };
+
+  // Size class a range of exactly this many units is filed under
+  static void mapping(uint64_t units, uint32_t &fl, uint32_t &sl) {
+    fl = mostSignificantBit(units);
+    uint64_t classes = fl >= SL_LOG2 ? units >> (fl - SL_LOG2) : units << (SL_LOG2 - fl);
+    sl = static_cast<uint32_t>(classes) - SL_COUNT;
+  }
+
+  // First free range of at least units, from the smallest size class guaranteed to fit
+  uint32_t findFree(uint64_t units) const {
+    uint32_t fl = mostSignificantBit(units);
+    if (fl >= SL_LOG2) {
+      units += (1ull << (fl - SL_LOG2)) - 1;
+    }
+    uint32_t sl;
+    mapping(units, fl, sl);
+
+    uint32_t slMap = slBitmaps[fl] & (~0u << sl);
+    if (slMap == 0) {
+      uint64_t flMap = fl + 1 < FL_COUNT ? flBitmap & (~0ull << (fl + 1)) : 0;
+      if (flMap == 0) return NONE;
+      fl = leastSignificantBit(flMap);
+      slMap = slBitmaps[fl];
+    }
+    return freeHeads[fl][leastSignificantBit(slMap)];
+  }
+
+  void insertFree(uint32_t index) {
+    uint32_t fl, sl;
+    mapping(chunks[index].units, fl, sl);
+    chunks[index].free = true;
+    chunks[index].prevFree = NONE;
+    chunks[index].nextFree = freeHeads[fl][sl];
+    if (freeHeads[fl][sl] != NONE) {
+      chunks[freeHeads[fl][sl]].prevFree = index;
+    }
+    freeHeads[fl][sl] = index;
+    slBitmaps[fl] |= 1u << sl;
+    flBitmap |= 1ull << fl;
+  }
+
+  void removeFree(uint32_t index) {
+    uint32_t fl, sl;
+    mapping(chunks[index].units, fl, sl);
+    Chunk &chunk = chunks[index];
+    if (chunk.prevFree != NONE) {
+      chunks[chunk.prevFree].nextFree = chunk.nextFree;
+    } else {
+      freeHeads[fl][sl] = chunk.nextFree;
+    }
+    if (chunk.nextFree != NONE) {
+      chunks[chunk.nextFree].prevFree = chunk.prevFree;
+    }
+    if (freeHeads[fl][sl] == NONE) {
+      slBitmaps[fl] &= ~(1u << sl);
+      if (slBitmaps[fl] == 0) {
+        flBitmap &= ~(1ull << fl);
+      }
+    }
+  }
+
+  // Drops a range that has been merged into a neighbour
+  void unlinkPhysical(uint32_t index) {
+    Chunk &chunk = chunks[index];
+    if (chunk.prevPhysical != NONE) {
+      chunks[chunk.prevPhysical].nextPhysical = chunk.nextPhysical;
+    }
+    if (chunk.nextPhysical != NONE) {
+      chunks[chunk.nextPhysical].prevPhysical = chunk.prevPhysical;
+    }
+    chunk = Chunk{};
+    unusedChunks.push_back(index);
+  }
+
+  uint32_t newChunk() {
+    if (!unusedChunks.empty()) {
+      uint32_t index = unusedChunks.back();
+      unusedChunks.pop_back();
+      return index;
+    }
+    chunks.emplace_back();
+    return static_cast<uint32_t>(chunks.size() - 1);
+  }
+
+  std::vector<Chunk> chunks;
+  std::vector<uint32_t> unusedChunks;
+  uint64_t flBitmap = 0;
+  std::array<uint32_t, FL_COUNT> slBitmaps{};
+  std::array<std::array<uint32_t, SL_COUNT>, FL_COUNT> freeHeads{};
+};
+
+LveMemoryAllocator::LveMemoryAllocator(
+    VkDevice device, VkPhysicalDevice physicalDevice, bool useDedicatedAllocations)
+    : device{device}, useDedicatedAllocations{useDedicatedAllocations} {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+
+  pools.resize(memoryProperties.memoryTypeCount * RESOURCE_KIND_COUNT);
+  dedicatedCounts.assign(memoryProperties.memoryHeapCount, 0);
+  dedicatedBytes.assign(memoryProperties.memoryHeapCount, 0);
+}
+
+LveMemoryAllocator::~LveMemoryAllocator() {
+  // Owners free everything before the device goes; whatever is left is released with the blocks
+  for (auto &pool : pools) {
+    for (auto &block : pool.blocks) {
+      freeDeviceMemory(block->memory, block->memoryType);
+    }
+  }
+}
+
+LveAllocation LveMemoryAllocator::allocateForBuffer(
+    VkBuffer buffer, VkMemoryPropertyFlags properties) {
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(device, buffer, &requirements);
+
+  LveAllocation allocation =
+      allocate(requirements, properties, LINEAR_RESOURCE, false, VK_NULL_HANDLE);
+  if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+    free(allocation);
+    throw std::runtime_error("failed to bind buffer memory!");
+  }
+  return allocation;
+}
+
+LveAllocation LveMemoryAllocator::allocateForImage(
+    VkImage image, VkMemoryPropertyFlags properties) {
+  VkMemoryRequirements requirements;
+  bool dedicated = false;
+  if (useDedicatedAllocations) {
+    VkMemoryDedicatedRequirements dedicatedRequirements{};
+    dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+    VkMemoryRequirements2 requirements2{};
+    requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements2.pNext = &dedicatedRequirements;
+    VkImageMemoryRequirementsInfo2 requirementsInfo{};
+    requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+    requirementsInfo.image = image;
+    vkGetImageMemoryRequirements2(device, &requirementsInfo, &requirements2);
+    requirements = requirements2.memoryRequirements;
+    dedicated = dedicatedRequirements.prefersDedicatedAllocation ||
+                dedicatedRequirements.requiresDedicatedAllocation;
+  } else {
+    vkGetImageMemoryRequirements(device, image, &requirements);
+  }
+  dedicated = dedicated || requirements.size >= DEDICATED_IMAGE_SIZE;
+
+  LveAllocation allocation = allocate(requirements, properties, OPTIMAL_IMAGE, dedicated, image);
+  if (vkBindImageMemory(device, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+    free(allocation);
+    throw std::runtime_error("failed to bind image memory!");
+  }
+  return allocation;
+}
+
+LveAllocation LveMemoryAllocator::allocate(
+    const VkMemoryRequirements &requirements,
+    VkMemoryPropertyFlags properties,
+    ResourceKind kind,
+    bool dedicated,
+    VkImage dedicatedImage) {
+  uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+  VkDeviceSize blockSize = getBlockSize(memoryType);
+
+  std::lock_guard<std::mutex> lock{mutex};
+  if (dedicated || requirements.size > blockSize / 2) {
+    return allocateDedicated(requirements, memoryType, dedicatedImage);
+  }
+
+  LveAllocation allocation{};
+  auto &pool = pools[memoryType * RESOURCE_KIND_COUNT + kind];
+  for (auto &block : pool.blocks) {
+    if (block->allocate(requirements.size, requirements.alignment, allocation)) {
+      return allocation;
+    }
+  }
+
+  void *mapped = nullptr;
+  VkDeviceMemory memory = allocateDeviceMemory(blockSize, memoryType, VK_NULL_HANDLE, &mapped);
+  pool.blocks.push_back(std::make_unique<LveMemoryBlock>(memory, blockSize, memoryType, mapped));
+  if (!pool.blocks.back()->allocate(requirements.size, requirements.alignment, allocation)) {
+    throw std::runtime_error("failed to sub-allocate from a new memory block!");
+  }
+  return allocation;
+}
+
+LveAllocation LveMemoryAllocator::allocateDedicated(
+    const VkMemoryRequirements &requirements, uint32_t memoryType, VkImage dedicatedImage) {
+  LveAllocation allocation{};
+  allocation.memory =
+      allocateDeviceMemory(requirements.size, memoryType, dedicatedImage, &allocation.mapped);
+  allocation.size = requirements.size;
+  allocation.memoryType = memoryType;
+
+  uint32_t heap = memoryProperties.memoryTypes[memoryType].heapIndex;
+  dedicatedCounts[heap]++;
+  dedicatedBytes[heap] += requirements.size;
+  return allocation;
+}
+
+VkDeviceMemory LveMemoryAllocator::allocateDeviceMemory(
+    VkDeviceSize size, uint32_t memoryType, VkImage dedicatedImage, void **mapped) {
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryType;
+
+  VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+  if (useDedicatedAllocations && dedicatedImage != VK_NULL_HANDLE) {
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.image = dedicatedImage;
+    allocInfo.pNext = &dedicatedInfo;
+  }
+
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate device memory!");
+  }
+
+  *mapped = nullptr;
+  if (isHostVisible(memoryType) &&
+      vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+    vkFreeMemory(device, memory, nullptr);
+    throw std::runtime_error("failed to map device memory!");
+  }
+  return memory;
+}
+
+void LveMemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, uint32_t memoryType) {
+  if (isHostVisible(memoryType)) {
+    vkUnmapMemory(device, memory);
+  }
+  vkFreeMemory(device, memory, nullptr);
+}
+
+void LveMemoryAllocator::free(const LveAllocation &allocation) {
+  if (allocation.memory == VK_NULL_HANDLE) return;
+
+  std::lock_guard<std::mutex> lock{mutex};
+  if (allocation.block == nullptr) {
+    uint32_t heap = memoryProperties.memoryTypes[allocation.memoryType].heapIndex;
+    dedicatedCounts[heap]--;
+    dedicatedBytes[heap] -= allocation.size;
+    freeDeviceMemory(allocation.memory, allocation.memoryType);
+    return;
+  }
+
+  LveMemoryBlock *block = allocation.block;
+  block->free(allocation.chunk);
+  if (!block->isEmpty()) return;
+
+  // One empty block per pool is kept, so a pool that drains and refills does not thrash
+  for (auto &pool : pools) {
+    auto it = std::find_if(pool.blocks.begin(), pool.blocks.end(), [block](const auto &candidate) {
+      return candidate.get() == block;
+    });
+    if (it == pool.blocks.end()) continue;
+
+    bool hasOtherEmpty =
+        std::any_of(pool.blocks.begin(), pool.blocks.end(), [block](const auto &candidate) {
+          return candidate.get() != block && candidate->isEmpty();
+        });
+    if (hasOtherEmpty) {
+      freeDeviceMemory(block->memory, block->memoryType);
+      pool.blocks.erase(it);
+    }
+    return;
+  }
+}
+
+VkResult LveMemoryAllocator::flush(
+    const LveAllocation &allocation, VkDeviceSize size, VkDeviceSize offset) {
+  if (memoryProperties.memoryTypes[allocation.memoryType].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {
+    return VK_SUCCESS;
+  }
+
+  VkDeviceSize memorySize = allocation.block != nullptr ? allocation.block->size : allocation.size;
+  VkDeviceSize begin = (allocation.offset + offset) / nonCoherentAtomSize * nonCoherentAtomSize;
+  VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size
+                                           : allocation.offset + offset + size;
+  end = alignUp(end, nonCoherentAtomSize);
+
+  VkMappedMemoryRange mappedRange = {};
+  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  mappedRange.memory = allocation.memory;
+  mappedRange.offset = begin;
+  // Past the atom-aligned end of the memory only VK_WHOLE_SIZE is valid
+  mappedRange.size = end >= memorySize ? VK_WHOLE_SIZE : end - begin;
+  return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
+}
+
+uint32_t LveMemoryAllocator::findMemoryType(
+    uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+std::vector<LveMemoryAllocator::HeapStats> LveMemoryAllocator::getHeapStats() const {
+  std::vector<HeapStats> stats(memoryProperties.memoryHeapCount);
+  for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+    stats[heap].heapSize = memoryProperties.memoryHeaps[heap].size;
+  }
+
+  std::lock_guard<std::mutex> lock{mutex};
+  for (const auto &pool : pools) {
+    for (const auto &block : pool.blocks) {
+      auto &heapStats = stats[memoryProperties.memoryTypes[block->memoryType].heapIndex];
+      heapStats.blockCount++;
+      heapStats.blockBytes += block->size;
+      heapStats.allocationCount += block->allocationCount;
+      heapStats.usedBytes += block->usedUnits * LveMemoryBlock::GRANULARITY;
+    }
+  }
+  for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+    stats[heap].dedicatedCount = dedicatedCounts[heap];
+    stats[heap].dedicatedBytes = dedicatedBytes[heap];
+  }
+  return stats;
+}
+
+uint32_t LveMemoryAllocator::getDeviceMemoryCount() const {
+  std::lock_guard<std::mutex> lock{mutex};
+  uint32_t count = 0;
+  for (const auto &pool : pools) {
+    count += static_cast<uint32_t>(pool.blocks.size());
+  }
+  for (uint32_t dedicatedCount : dedicatedCounts) {
+    count += dedicatedCount;
+  }
+  return count;
+}
+
+VkDeviceSize LveMemoryAllocator::getBlockSize(uint32_t memoryType) const {
+  VkDeviceSize heapSize =
+      memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+  VkDeviceSize blockSize = std::min(DEFAULT_BLOCK_SIZE, heapSize / 8);
+  return std::max(
+      blockSize / LveMemoryBlock::GRANULARITY * LveMemoryBlock::GRANULARITY,
+      LveMemoryBlock::GRANULARITY);
+}
+
+bool LveMemoryAllocator::isHostVisible(uint32_t memoryType) const {
+  return (memoryProperties.memoryTypes[memoryType].propertyFlags &
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+}  // namespace lve
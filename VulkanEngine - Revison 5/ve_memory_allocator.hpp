@@ -0,0 +1,116 @@
+#pragma once
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lve {
+
+class LveMemoryBlock;
+
+// A range of device memory handed out by LveMemoryAllocator. Bind resources at memory + offset,
+// and give it back with LveMemoryAllocator::free.
+struct LveAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  // Host address of offset when the memory is host visible (blocks stay mapped), else nullptr
+  void *mapped = nullptr;
+
+  // Where the range came from; block is null for a dedicated allocation
+  LveMemoryBlock *block = nullptr;
+  uint32_t chunk = 0;
+  uint32_t memoryType = 0;
+};
+
+// Reserves large VkDeviceMemory blocks per memory type and sub-allocates buffers and images from
+// them, so the number of live vkAllocateMemory calls stays far below maxMemoryAllocationCount.
+// Each block is managed as a two-level segregated fit (TLSF) heap: free ranges are binned by size
+// class with a bitmap per level, so finding, splitting and merging are all constant time.
+// Buffers and optimal-tiling images come from separate blocks, so bufferImageGranularity never
+// has to be padded for. Large images, and anything bigger than half a block, get a dedicated
+// allocation of their own. Internally synchronized.
+class LveMemoryAllocator {
+ public:
+  // Heaps smaller than 8 blocks use blocks of an eighth of the heap instead
+  static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull << 20;
+  // Images at least this large always get a dedicated allocation
+  static constexpr VkDeviceSize DEDICATED_IMAGE_SIZE = 16ull << 20;
+
+  struct HeapStats {
+    VkDeviceSize heapSize = 0;
+    uint32_t blockCount = 0;
+    // Reserved in blocks, whether sub-allocated or not
+    VkDeviceSize blockBytes = 0;
+    uint32_t allocationCount = 0;
+    // Sub-allocated from blocks, including alignment padding
+    VkDeviceSize usedBytes = 0;
+    uint32_t dedicatedCount = 0;
+    VkDeviceSize dedicatedBytes = 0;
+  };
+
+  // useDedicatedAllocations: the device supports Vulkan 1.1, so images can ask the driver whether
+  // they prefer a dedicated allocation and be allocated as one
+  LveMemoryAllocator(
+      VkDevice device, VkPhysicalDevice physicalDevice, bool useDedicatedAllocations);
+  ~LveMemoryAllocator();
+
+  LveMemoryAllocator(const LveMemoryAllocator &) = delete;
+  LveMemoryAllocator &operator=(const LveMemoryAllocator &) = delete;
+
+  // Allocate memory satisfying the resource's requirements and bind it
+  LveAllocation allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+  LveAllocation allocateForImage(VkImage image, VkMemoryPropertyFlags properties);
+  // The resource bound to the allocation must already be destroyed, or at least no longer used
+  void free(const LveAllocation &allocation);
+
+  // Makes host writes to [offset, offset + size) of the allocation visible to the device; a no-op
+  // for coherent memory. The range is widened to nonCoherentAtomSize as the spec requires.
+  VkResult flush(
+      const LveAllocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+  uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+  std::vector<HeapStats> getHeapStats() const;
+  // Live VkDeviceMemory objects: blocks plus dedicated allocations
+  uint32_t getDeviceMemoryCount() const;
+
+ private:
+  enum ResourceKind : uint32_t { LINEAR_RESOURCE = 0, OPTIMAL_IMAGE = 1, RESOURCE_KIND_COUNT };
+
+  struct Pool {
+    std::vector<std::unique_ptr<LveMemoryBlock>> blocks;
+  };
+
+  LveAllocation allocate(
+      const VkMemoryRequirements &requirements,
+      VkMemoryPropertyFlags properties,
+      ResourceKind kind,
+      bool dedicated,
+      VkImage dedicatedImage);
+  LveAllocation allocateDedicated(
+      const VkMemoryRequirements &requirements, uint32_t memoryType, VkImage dedicatedImage);
+  VkDeviceMemory allocateDeviceMemory(
+      VkDeviceSize size, uint32_t memoryType, VkImage dedicatedImage, void **mapped);
+  void freeDeviceMemory(VkDeviceMemory memory, uint32_t memoryType);
+  VkDeviceSize getBlockSize(uint32_t memoryType) const;
+  bool isHostVisible(uint32_t memoryType) const;
+
+  VkDevice device;
+  VkPhysicalDeviceMemoryProperties memoryProperties{};
+  VkDeviceSize nonCoherentAtomSize = 1;
+  bool useDedicatedAllocations;
+
+  mutable std::mutex mutex;
+  // Indexed by memoryType * RESOURCE_KIND_COUNT + kind
+  std::vector<Pool> pools;
+  std::vector<uint32_t> dedicatedCounts;
+  std::vector<VkDeviceSize> dedicatedBytes;
+};
+
+}  // namespace lve
@@ -1,61 +1,139 @@
 #include "ve_model.hpp"
 
+#include "ve_geometry_pool.hpp"
+#include "ve_upload_manager.hpp"
+
 // std
 #include <cassert>
-#include <cstring>
 
 namespace lve {
 
-LveModel::LveModel(LveDevice &device, const std::vector<Vertex> &vertices) : lveDevice{device} {
+std::atomic<uint32_t> LveModel::nextId{0};
+
+LveModel::LveModel(LveDevice &device, const std::vector<Vertex> &vertices, VertexFormat format)
+    : lveDevice{device}, vertexFormat{format} {
   createVertexBuffers(vertices);
 }
 
-LveModel::LveModel(LveDevice &device, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices) : lveDevice{device} {
+LveModel::LveModel(
+    LveDevice &device,
+    const std::vector<Vertex> &vertices,
+    const std::vector<uint32_t> &indices,
+    LveGeometryPool *geometryPool,
+    VertexFormat format)
+    : lveDevice{device}, vertexFormat{format} {
+  if (geometryPool != nullptr && !indices.empty()) {
+    // Pooled models only keep a handle to where their data landed; the pool owns the buffers
+    vertexFormat = geometryPool->getVertexFormat();
+    computeBounds(vertices);
+    std::vector<QuantizedVertex> quantized;
+    const void *vertexData = encodeVertices(vertices, quantized);
+    poolHandle = geometryPool->allocate(
+        vertexData, static_cast<uint32_t>(vertices.size()), indices);
+    this->geometryPool = geometryPool;
+    vertexCount = static_cast<uint32_t>(vertices.size());
+    hasIndexBuffer = true;
+    return;
+  }
+
   createVertexBuffers(vertices);
   createIndexBuffers(indices);
 }
 
 LveModel::~LveModel() {
-  vkDestroyBuffer(lveDevice.device(), vertexBuffer, nullptr);
-  vkFreeMemory(lveDevice.device(), vertexBufferMemory, nullptr);
-  
-  if (hasIndexBuffer) {
-    vkDestroyBuffer(lveDevice.device(), indexBuffer, nullptr);
-    vkFreeMemory(lveDevice.device(), indexBufferMemory, nullptr);
+  if (geometryPool != nullptr) {
+    geometryPool->free(poolHandle);
+    return;
+  }
+
+  // Released once the frames that may still draw the model have completed
+  VkDevice device = lveDevice.device();
+  LveMemoryAllocator *allocator = &lveDevice.memoryAllocator();
+  VkBuffer retiredVertexBuffer = vertexBuffer;
+  LveAllocation retiredVertexAllocation = vertexAllocation;
+  VkBuffer retiredIndexBuffer = hasIndexBuffer ? indexBuffer : VK_NULL_HANDLE;
+  LveAllocation retiredIndexAllocation = hasIndexBuffer ? indexAllocation : LveAllocation{};
+  lveDevice.deletionQueue().push([=]() {
+    vkDestroyBuffer(device, retiredVertexBuffer, nullptr);
+    allocator->free(retiredVertexAllocation);
+    if (retiredIndexBuffer != VK_NULL_HANDLE) {
+      vkDestroyBuffer(device, retiredIndexBuffer, nullptr);
+      allocator->free(retiredIndexAllocation);
+    }
+  });
+}
+
+void LveModel::computeBounds(const std::vector<Vertex> &vertices) {
+  if (vertices.empty()) return;
+
+  boundingBox.min = vertices[0].position;
+  boundingBox.max = vertices[0].position;
+  for (const auto &vertex : vertices) {
+    boundingBox.min = glm::min(boundingBox.min, vertex.position);
+    boundingBox.max = glm::max(boundingBox.max, vertex.position);
+  }
+
+  // Centered on the box, but sized from the vertices: tighter than the box's half diagonal
+  boundingSphere.center = (boundingBox.min + boundingBox.max) * 0.5f;
+  float maxDistanceSquared = 0.0f;
+  for (const auto &vertex : vertices) {
+    glm::vec3 offset = vertex.position - boundingSphere.center;
+    maxDistanceSquared = glm::max(maxDistanceSquared, glm::dot(offset, offset));
   }
+  boundingSphere.radius = glm::sqrt(maxDistanceSquared);
 }
 
 void LveModel::createVertexBuffers(const std::vector<Vertex> &vertices) {
   vertexCount = static_cast<uint32_t>(vertices.size());
   assert(vertexCount >= 3 && "Vertex count must be at least 3");
-  
-  VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-  
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  lveDevice.createBuffer(
-      bufferSize,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      stagingBuffer,
-      stagingBufferMemory);
+  computeBounds(vertices);
+  std::vector<QuantizedVertex> quantized;
+  const void *vertexData = encodeVertices(vertices, quantized);
 
-  void *data;
-  vkMapMemory(lveDevice.device(), stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-  vkUnmapMemory(lveDevice.device(), stagingBufferMemory);
+  VkDeviceSize bufferSize = static_cast<VkDeviceSize>(getVertexStride(vertexFormat)) * vertexCount;
 
   lveDevice.createBuffer(
       bufferSize,
       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
       vertexBuffer,
-      vertexBufferMemory);
+      vertexAllocation);
+
+  // Copied with the next frame's upload batch; the buffer is destroyed no earlier than that frame
+  lveDevice.uploadManager().upload(vertexBuffer, 0, vertexData, bufferSize);
+}
+
+const void *LveModel::encodeVertices(
+    const std::vector<Vertex> &vertices, std::vector<QuantizedVertex> &quantized) {
+  if (vertexFormat == VertexFormat::FLOAT32) return vertices.data();
 
-  lveDevice.copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+  // Each axis spans the bounding box; a flat axis (a plane's thickness) encodes as 0
+  glm::vec3 extent = boundingBox.max - boundingBox.min;
+  glm::vec3 scale{0.0f};
+  for (int axis = 0; axis < 3; axis++) {
+    if (extent[axis] > 0.0f) scale[axis] = 65535.0f / extent[axis];
+  }
+
+  quantized.resize(vertices.size());
+  for (size_t i = 0; i < vertices.size(); i++) {
+    glm::vec3 position = glm::round((vertices[i].position - boundingBox.min) * scale);
+    position = glm::clamp(position, glm::vec3{0.0f}, glm::vec3{65535.0f});
+    glm::vec3 color = glm::round(glm::clamp(vertices[i].color, 0.0f, 1.0f) * 255.0f);
+    for (int axis = 0; axis < 3; axis++) {
+      quantized[i].position[axis] = static_cast<uint16_t>(position[axis]);
+      quantized[i].color[axis] = static_cast<uint8_t>(color[axis]);
+    }
+    quantized[i].position[3] = 0;
+    quantized[i].color[3] = 255;
+  }
 
-  vkDestroyBuffer(lveDevice.device(), stagingBuffer, nullptr);
-  vkFreeMemory(lveDevice.device(), stagingBufferMemory, nullptr);
+  // UNORM attributes arrive in [0, 1]; scale by the extent and move to the box's corner
+  dequantization = glm::mat4{1.0f};
+  dequantization[0][0] = extent.x;
+  dequantization[1][1] = extent.y;
+  dequantization[2][2] = extent.z;
+  dequantization[3] = glm::vec4{boundingBox.min, 1.0f};
+  return quantized.data();
 }
 
 void LveModel::createIndexBuffers(const std::vector<uint32_t> &indices) {
@@ -67,72 +145,130 @@ void LveModel::createIndexBuffers(const std::vector<uint32_t> &indices) {
   }
   
   VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-  
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  lveDevice.createBuffer(
-      bufferSize,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      stagingBuffer,
-      stagingBufferMemory);
-
-  void *data;
-  vkMapMemory(lveDevice.device(), stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, indices.data(), static_cast<size_t>(bufferSize));
-  vkUnmapMemory(lveDevice.device(), stagingBufferMemory);
 
   lveDevice.createBuffer(
       bufferSize,
       VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
       indexBuffer,
-      indexBufferMemory);
+      indexAllocation);
 
-  lveDevice.copyBuffer(stagingBuffer, indexBuffer, bufferSize);
-
-  vkDestroyBuffer(lveDevice.device(), stagingBuffer, nullptr);
-  vkFreeMemory(lveDevice.device(), stagingBufferMemory, nullptr);
+  lveDevice.uploadManager().upload(indexBuffer, 0, indices.data(), bufferSize);
 }
 
 void LveModel::bind(VkCommandBuffer commandBuffer) {
+  if (geometryPool != nullptr) {
+    geometryPool->bind(commandBuffer);
+    return;
+  }
+
   VkBuffer buffers[] = {vertexBuffer};
   VkDeviceSize offsets[] = {0};
-  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+  vkCmdBindVertexBuffers(commandBuffer, VERTEX_BINDING, 1, buffers, offsets);
   
   if (hasIndexBuffer) {
     vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
   }
 }
 
-void LveModel::draw(VkCommandBuffer commandBuffer) {
-  if (hasIndexBuffer) {
-    vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+void LveModel::bind(VkCommandBuffer commandBuffer, LveGeometryPool *&boundPool) {
+  if (geometryPool != nullptr && geometryPool == boundPool) return;
+  bind(commandBuffer);
+  boundPool = geometryPool;
+}
+
+void LveModel::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance) {
+  if (geometryPool != nullptr) {
+    const LveGeometryPool::Range &range = geometryPool->getRange(poolHandle);
+    vkCmdDrawIndexed(
+        commandBuffer,
+        range.indexCount,
+        instanceCount,
+        range.firstIndex,
+        range.vertexOffset,
+        firstInstance);
+  } else if (hasIndexBuffer) {
+    vkCmdDrawIndexed(
+        commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
   } else {
-    vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+    vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
   }
 }
 
+uint32_t LveModel::getIndexCount() const {
+  return geometryPool != nullptr ? geometryPool->getRange(poolHandle).indexCount : indexCount;
+}
+
+uint32_t LveModel::getFirstIndex() const {
+  return geometryPool != nullptr ? geometryPool->getRange(poolHandle).firstIndex : firstIndex;
+}
+
+int32_t LveModel::getVertexOffset() const {
+  return geometryPool != nullptr ? geometryPool->getRange(poolHandle).vertexOffset : vertexOffset;
+}
+
 std::vector<VkVertexInputBindingDescription> LveModel::Vertex::getBindingDescriptions() {
-  std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
-  bindingDescriptions[0].binding = 0;
-  bindingDescriptions[0].stride = sizeof(Vertex);
+  return LveModel::getBindingDescriptions(VertexFormat::FLOAT32);
+}
+
+std::vector<VkVertexInputAttributeDescription> LveModel::Vertex::getAttributeDescriptions() {
+  return LveModel::getAttributeDescriptions(VertexFormat::FLOAT32);
+}
+
+uint32_t LveModel::getVertexStride(VertexFormat format) {
+  return format == VertexFormat::QUANTIZED ? sizeof(QuantizedVertex) : sizeof(Vertex);
+}
+
+std::vector<VkVertexInputBindingDescription> LveModel::getBindingDescriptions(
+    VertexFormat format) {
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions(2);
+  bindingDescriptions[0].binding = VERTEX_BINDING;
+  bindingDescriptions[0].stride = getVertexStride(format);
   bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+  bindingDescriptions[1].binding = INSTANCE_BINDING;
+  bindingDescriptions[1].stride = sizeof(InstanceData);
+  bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
   return bindingDescriptions;
 }
 
-std::vector<VkVertexInputAttributeDescription> LveModel::Vertex::getAttributeDescriptions() {
+std::vector<VkVertexInputAttributeDescription> LveModel::getAttributeDescriptions(
+    VertexFormat format) {
   std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
   
-  attributeDescriptions[0].binding = 0;
+  // The shader reads vec3s either way; normalized formats are converted by the vertex fetch
+  attributeDescriptions[0].binding = VERTEX_BINDING;
   attributeDescriptions[0].location = 0;
-  attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attributeDescriptions[0].offset = offsetof(Vertex, position);
-  
-  attributeDescriptions[1].binding = 0;
+  attributeDescriptions[1].binding = VERTEX_BINDING;
   attributeDescriptions[1].location = 1;
-  attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attributeDescriptions[1].offset = offsetof(Vertex, color);
+  if (format == VertexFormat::QUANTIZED) {
+    attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+    attributeDescriptions[0].offset = offsetof(QuantizedVertex, position);
+    attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+    attributeDescriptions[1].offset = offsetof(QuantizedVertex, color);
+  } else {
+    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[0].offset = offsetof(Vertex, position);
+    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[1].offset = offsetof(Vertex, color);
+  }
+
+  // A mat4 attribute occupies four consecutive locations, one per column
+  for (uint32_t column = 0; column < 4; column++) {
+    VkVertexInputAttributeDescription attribute{};
+    attribute.binding = INSTANCE_BINDING;
+    attribute.location = 2 + column;
+    attribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attribute.offset = offsetof(InstanceData, modelMatrix) + sizeof(glm::vec4) * column;
+    attributeDescriptions.push_back(attribute);
+  }
+
+  VkVertexInputAttributeDescription colorAttribute{};
+  colorAttribute.binding = INSTANCE_BINDING;
+  colorAttribute.location = 6;
+  colorAttribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+  colorAttribute.offset = offsetof(InstanceData, color);
+  attributeDescriptions.push_back(colorAttribute);
   
   return attributeDescriptions;
 }
@@ -8,40 +8,133 @@
  #include <glm/glm.hpp>
  
  // std
+ #include <atomic>
  #include <vector>
  
  namespace lve {
+ class LveGeometryPool;
+
  class LveModel {
   public:
+   // How a mesh's vertices are stored on the GPU; chosen per mesh at creation. Pipelines drawing
+   // a mesh must be built for its format (PipelineConfigInfo::vertexFormat).
+   enum class VertexFormat : uint32_t {
+     // Vertex as is: 24 bytes
+     FLOAT32,
+     // QuantizedVertex: 12 bytes. Positions are 16-bit normalized within the mesh's bounding box;
+     // getDequantization() maps them back and is folded into the instance matrix.
+     QUANTIZED,
+   };
+
    struct Vertex {
      glm::vec3 position;  // Changed from vec2 to vec3
      glm::vec3 color;
 
+     // The FLOAT32 layout
      static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
      static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
    };
 
-   LveModel(LveDevice &device, const std::vector<Vertex> &vertices);
-   LveModel(LveDevice &device, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
+   struct QuantizedVertex {
+     // R16G16B16A16_UNORM; the fourth component is padding, as three-component 16-bit vertex
+     // formats are rarely supported
+     uint16_t position[4];
+     // R8G8B8A8_UNORM
+     uint8_t color[4];
+   };
+   static_assert(sizeof(QuantizedVertex) == 12, "QuantizedVertex must stay tightly packed");
+
+   // Per-instance data streamed through binding 1 (VK_VERTEX_INPUT_RATE_INSTANCE)
+   struct InstanceData {
+     glm::mat4 modelMatrix{1.0f};
+     glm::vec4 color{1.0f};
+   };
+
+   // Local-space bounds, computed once from the vertex data
+   struct BoundingBox {
+     glm::vec3 min{0.0f};
+     glm::vec3 max{0.0f};
+   };
+
+   struct BoundingSphere {
+     glm::vec3 center{0.0f};
+     float radius = 0.0f;
+   };
+
+   static constexpr uint32_t VERTEX_BINDING = 0;
+   static constexpr uint32_t INSTANCE_BINDING = 1;
+
+   static uint32_t getVertexStride(VertexFormat format);
+   static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(VertexFormat format);
+   static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(
+       VertexFormat format);
+
+   LveModel(
+       LveDevice &device,
+       const std::vector<Vertex> &vertices,
+       VertexFormat format = VertexFormat::FLOAT32);
+   // Indexed models given a geometry pool live in its shared buffers instead of owning their own,
+   // and are stored in the pool's vertex format; format applies to models with their own buffers
+   LveModel(
+       LveDevice &device,
+       const std::vector<Vertex> &vertices,
+       const std::vector<uint32_t> &indices,
+       LveGeometryPool *geometryPool = nullptr,
+       VertexFormat format = VertexFormat::FLOAT32);
    ~LveModel();   LveModel(const LveModel &) = delete;
    LveModel &operator=(const LveModel &) = delete;
  
    void bind(VkCommandBuffer commandBuffer);
-   void draw(VkCommandBuffer commandBuffer);
+   // Skips the bind when boundPool already holds this model's geometry, and leaves boundPool set
+   // to what is bound afterwards (nullptr for a model with its own buffers). Start each command
+   // buffer with boundPool = nullptr.
+   void bind(VkCommandBuffer commandBuffer, LveGeometryPool *&boundPool);
+   void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+
+   // Unique per model; used in render queue sort keys
+   uint32_t getId() const { return id; }
+
+   const BoundingBox &getBoundingBox() const { return boundingBox; }
+   VertexFormat getVertexFormat() const { return vertexFormat; }
+   // Takes stored positions back to model space; the identity unless the format is QUANTIZED
+   const glm::mat4 &getDequantization() const { return dequantization; }
+   const BoundingSphere &getBoundingSphere() const { return boundingSphere; }
+
+   LveGeometryPool *getGeometryPool() const { return geometryPool; }
+   bool hasIndices() const { return hasIndexBuffer; }
+   // Pooled models look these up in the pool, since compaction can move them
+   uint32_t getIndexCount() const;
+   uint32_t getFirstIndex() const;
+   int32_t getVertexOffset() const;
  
   private:
+   void computeBounds(const std::vector<Vertex> &vertices);
+   // Converts to the model's vertex format; returns vertices itself for FLOAT32
+   const void *encodeVertices(
+       const std::vector<Vertex> &vertices, std::vector<QuantizedVertex> &quantized);
    void createVertexBuffers(const std::vector<Vertex> &vertices);
    void createIndexBuffers(const std::vector<uint32_t> &indices);
 
+   static std::atomic<uint32_t> nextId;
+
    LveDevice &lveDevice;
+   const uint32_t id = nextId++;
+   LveGeometryPool *geometryPool = nullptr;
+   uint32_t poolHandle = 0;
+   BoundingBox boundingBox{};
+   BoundingSphere boundingSphere{};
+   VertexFormat vertexFormat = VertexFormat::FLOAT32;
+   glm::mat4 dequantization{1.0f};
    
-   VkBuffer vertexBuffer;
-   VkDeviceMemory vertexBufferMemory;
+   VkBuffer vertexBuffer = VK_NULL_HANDLE;
+   LveAllocation vertexAllocation{};
    uint32_t vertexCount;
+   int32_t vertexOffset = 0;
    
    bool hasIndexBuffer = false;
-   VkBuffer indexBuffer;
-   VkDeviceMemory indexBufferMemory;
-   uint32_t indexCount;
+   VkBuffer indexBuffer = VK_NULL_HANDLE;
+   LveAllocation indexAllocation{};
+   uint32_t indexCount = 0;
+   uint32_t firstIndex = 0;
  };
  }  // namespace lve
\ No newline at end of file
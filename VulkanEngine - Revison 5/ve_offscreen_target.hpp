@@ -0,0 +1,77 @@
+#pragma once
+
+#include "ve_device.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <vector>
+
+namespace lve {
+
+// Stand-in for LveSwapChain when there is no window: one color and depth image per frame in
+// flight, rendered with a render pass compatible with the swap chain's (same formats, attachments
+// and subpass), so pipelines built for either work with both. Frames are paced by fences only.
+class LveOffscreenTarget {
+ public:
+  static constexpr VkFormat DEFAULT_COLOR_FORMAT = VK_FORMAT_B8G8R8A8_SRGB;
+
+  LveOffscreenTarget(
+      LveDevice &deviceRef, VkExtent2D extent, VkFormat colorFormat = DEFAULT_COLOR_FORMAT);
+  ~LveOffscreenTarget();
+
+  LveOffscreenTarget(const LveOffscreenTarget &) = delete;
+  LveOffscreenTarget &operator=(const LveOffscreenTarget &) = delete;
+
+  VkFramebuffer getFrameBuffer(int index) { return framebuffers[index]; }
+  VkRenderPass getRenderPass() { return renderPass; }
+  VkImage getColorImage(int index) { return colorImages[index]; }
+  VkFormat getColorFormat() { return colorFormat; }
+  VkExtent2D getExtent() { return extent; }
+
+  float extentAspectRatio() {
+    return static_cast<float>(extent.width) / static_cast<float>(extent.height);
+  }
+  VkFormat findDepthFormat();
+
+  int getCurrentFrameIndex() const { return static_cast<int>(currentFrame); }
+  // Numbered like LveSwapChain's frames: from 1 in submission order
+  uint64_t getSubmittedFrameNumber() const { return submittedFrameCount; }
+  uint64_t getCompletedFrameNumber() const { return completedFrameCount; }
+
+  // Waits until the current frame slot's previous submission has finished and returns the slot,
+  // which is also the index of the framebuffer to render into
+  int acquireFrame();
+  // Submits bufferCount buffers in order as one batch and moves on to the next frame slot
+  void submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t bufferCount = 1);
+
+ private:
+  void createImages();
+  void createRenderPass();
+  void createFramebuffers();
+  void createSyncObjects();
+
+  LveDevice &device;
+  VkExtent2D extent;
+  VkFormat colorFormat;
+
+  VkRenderPass renderPass;
+  std::vector<VkFramebuffer> framebuffers;
+
+  std::vector<VkImage> colorImages;
+  std::vector<LveAllocation> colorImageAllocations;
+  std::vector<VkImageView> colorImageViews;
+  std::vector<VkImage> depthImages;
+  std::vector<LveAllocation> depthImageAllocations;
+  std::vector<VkImageView> depthImageViews;
+
+  std::vector<VkFence> inFlightFences;
+  // Frame number last submitted from each frame slot, 0 if none
+  std::vector<uint64_t> frameNumbers;
+  uint64_t submittedFrameCount = 0;
+  uint64_t completedFrameCount = 0;
+  size_t currentFrame = 0;
+};
+
+}  // namespace lve
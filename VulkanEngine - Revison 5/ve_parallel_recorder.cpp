@@ -0,0 +1,136 @@
+#include "ve_parallel_recorder.hpp"
+
+#include "ve_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <future>
+#include <stdexcept>
+
+namespace lve {
+
+LveParallelRecorder::LveParallelRecorder(LveDevice &device, LveThreadPool &threadPool)
+    : lveDevice{device}, threadPool{threadPool} {
+  QueueFamilyIndices queueFamilyIndices = lveDevice.findPhysicalQueueFamilies();
+
+  frameCommands.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  for (auto &workers : frameCommands) {
+    workers.resize(threadPool.getThreadCount());
+    for (auto &commands : workers) {
+      VkCommandPoolCreateInfo poolInfo{};
+      poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+      poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+      if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &commands.commandPool) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("failed to create secondary command pool!");
+      }
+
+      VkCommandBufferAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      allocInfo.commandPool = commands.commandPool;
+      allocInfo.commandBufferCount = 1;
+
+      if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &commands.commandBuffer) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate secondary command buffer!");
+      }
+    }
+  }
+}
+
+LveParallelRecorder::~LveParallelRecorder() {
+  // Destroying a pool frees the command buffers allocated from it
+  for (auto &workers : frameCommands) {
+    for (auto &commands : workers) {
+      vkDestroyCommandPool(lveDevice.device(), commands.commandPool, nullptr);
+    }
+  }
+}
+
+void LveParallelRecorder::record(
+    VkCommandBuffer primaryCommandBuffer,
+    int frameIndex,
+    VkRenderPass renderPass,
+    VkFramebuffer framebuffer,
+    uint32_t itemCount,
+    const RecordFn &recordFn) {
+  assert(frameIndex >= 0 && frameIndex < LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+  lastChunkCount = 0;
+  if (itemCount == 0) return;
+
+  auto &workers = frameCommands[frameIndex];
+  uint32_t maxChunks = (itemCount + MIN_ITEMS_PER_CHUNK - 1) / MIN_ITEMS_PER_CHUNK;
+  uint32_t chunkCount = std::min(static_cast<uint32_t>(workers.size()), maxChunks);
+  uint32_t chunkSize = (itemCount + chunkCount - 1) / chunkCount;
+
+  std::vector<std::future<void>> recordings;
+  std::vector<VkCommandBuffer> secondaryCommandBuffers;
+  recordings.reserve(chunkCount);
+  secondaryCommandBuffers.reserve(chunkCount);
+  for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+    uint32_t first = chunk * chunkSize;
+    if (first >= itemCount) break;
+    uint32_t count = std::min(chunkSize, itemCount - first);
+
+    WorkerCommands &commands = workers[chunk];
+    recordings.push_back(threadPool.submit([this, &commands, renderPass, framebuffer, first, count,
+                                            &recordFn]() {
+      recordChunk(commands, renderPass, framebuffer, first, count, recordFn);
+    }));
+    secondaryCommandBuffers.push_back(commands.commandBuffer);
+  }
+
+  // get() rethrows anything a worker threw; wait for all of them before touching the primary
+  for (auto &recording : recordings) {
+    recording.wait();
+  }
+  for (auto &recording : recordings) {
+    recording.get();
+  }
+
+  lastChunkCount = static_cast<uint32_t>(secondaryCommandBuffers.size());
+  vkCmdExecuteCommands(
+      primaryCommandBuffer,
+      static_cast<uint32_t>(secondaryCommandBuffers.size()),
+      secondaryCommandBuffers.data());
+}
+
+void LveParallelRecorder::recordChunk(
+    WorkerCommands &commands,
+    VkRenderPass renderPass,
+    VkFramebuffer framebuffer,
+    uint32_t first,
+    uint32_t count,
+    const RecordFn &recordFn) {
+  // The frame's fence has been waited on, so everything recorded from this pool last time is done
+  vkResetCommandPool(lveDevice.device(), commands.commandPool, 0);
+
+  VkCommandBufferInheritanceInfo inheritanceInfo{};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = renderPass;
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = framebuffer;
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                    VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  if (vkBeginCommandBuffer(commands.commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording secondary command buffer!");
+  }
+
+  recordFn(commands.commandBuffer, first, count);
+
+  if (vkEndCommandBuffer(commands.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record secondary command buffer!");
+  }
+}
+
+}  // namespace lve
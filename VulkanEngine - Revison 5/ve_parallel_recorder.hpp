@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ve_device.hpp"
+#include "ve_thread_pool.hpp"
+
+// std
+#include <functional>
+#include <vector>
+
+namespace lve {
+
+// Splits a draw list across worker threads, each recording a secondary command buffer that
+// continues the primary's render pass. Every worker slot owns one command pool per frame in
+// flight, so recording needs no locking and a frame's pools can be reset wholesale once its fence
+// has been waited on.
+class LveParallelRecorder {
+ public:
+  // Below this many items per chunk the cost of a secondary buffer outweighs the parallelism
+  static constexpr uint32_t MIN_ITEMS_PER_CHUNK = 8;
+
+  // Records items [first, first + count) into a secondary command buffer. Dynamic state and
+  // bindings are not inherited from the primary, so the callback must set them up itself.
+  using RecordFn = std::function<void(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count)>;
+
+  LveParallelRecorder(LveDevice &device, LveThreadPool &threadPool);
+  ~LveParallelRecorder();
+
+  LveParallelRecorder(const LveParallelRecorder &) = delete;
+  LveParallelRecorder &operator=(const LveParallelRecorder &) = delete;
+
+  // Records itemCount items across the workers and executes the resulting secondaries from
+  // primaryCommandBuffer, whose render pass must have been begun with
+  // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. Blocks until every chunk is recorded.
+  void record(
+      VkCommandBuffer primaryCommandBuffer,
+      int frameIndex,
+      VkRenderPass renderPass,
+      VkFramebuffer framebuffer,
+      uint32_t itemCount,
+      const RecordFn &recordFn);
+
+  uint32_t getLastChunkCount() const { return lastChunkCount; }
+
+ private:
+  struct WorkerCommands {
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+  };
+
+  void recordChunk(
+      WorkerCommands &commands,
+      VkRenderPass renderPass,
+      VkFramebuffer framebuffer,
+      uint32_t first,
+      uint32_t count,
+      const RecordFn &recordFn);
+
+  LveDevice &lveDevice;
+  LveThreadPool &threadPool;
+
+  // Indexed [frameIndex][worker]
+  std::vector<std::vector<WorkerCommands>> frameCommands;
+  uint32_t lastChunkCount = 0;
+};
+
+}  // namespace lve
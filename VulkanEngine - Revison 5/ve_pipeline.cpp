@@ -3,12 +3,14 @@
 #include "ve_model.hpp"
 
 #include <cassert>
-#include <fstream>
+#include <cstring>
 #include <stdexcept>
 #include <iostream>
 
 namespace lve
 {
+    std::atomic<uint32_t> vePipeline::nextId{1};
+
     vePipeline::vePipeline(LveDevice& device, const std::string& vertFilepath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo) : lveDevice{device}
     {
         createGraphicsPipeline(vertFilepath, fragFilePath, configInfo);
@@ -16,40 +18,25 @@ namespace lve
 
     vePipeline::~vePipeline() 
     {
-        vkDestroyShaderModule(lveDevice.device(), vertShaderModule, nullptr);
-        vkDestroyShaderModule(lveDevice.device(), fragShaderModule, nullptr);
         vkDestroyPipeline(lveDevice.device(), graphicsPipeline, nullptr);
     }
 
-    std::vector<char> vePipeline::readFile(const std::string& filepath)
-    {
-        std::ifstream file{filepath, std::ios::ate | std::ios::binary};
-
-        if (!file.is_open())
-        {
-            throw std::runtime_error("failed to open file: " + filepath);
-        }
-
-        size_t fileSize = static_cast<size_t>(file.tellg());
-        std::vector<char> buffer(fileSize);
-
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-
-        file.close();
-        return buffer;
-    }
-
     void vePipeline::createGraphicsPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo)
     {
         assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Connot create graphics pipelineLayout provided in configInfo");
         assert(configInfo.renderPass != VK_NULL_HANDLE && "Connot create graphics renderPass provided in configInfo");
 
-        auto vertCode = readFile(vertFilePath);
-        auto fragCode = readFile(fragFilePath);
+        vertShaderModule = lveDevice.shaderModuleCache().getModule(vertFilePath);
+        fragShaderModule = lveDevice.shaderModuleCache().getModule(fragFilePath);
 
-        creatShaderModule(vertCode, &vertShaderModule);
-        creatShaderModule(fragCode, &fragShaderModule);
+        // The driver folds the constants in when compiling, so branches on them cost nothing
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = static_cast<uint32_t>(configInfo.specializationMapEntries.size());
+        specializationInfo.pMapEntries = configInfo.specializationMapEntries.data();
+        specializationInfo.dataSize = configInfo.specializationData.size() * sizeof(uint32_t);
+        specializationInfo.pData = configInfo.specializationData.data();
+        const VkSpecializationInfo* stageSpecialization =
+            configInfo.specializationMapEntries.empty() ? nullptr : &specializationInfo;
 
         VkPipelineShaderStageCreateInfo shaderStages[2];
         shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -58,17 +45,17 @@ namespace lve
         shaderStages[0].pName = "main";
         shaderStages[0].flags = 0;
         shaderStages[0].pNext = nullptr;
-        shaderStages[0].pSpecializationInfo = nullptr;
+        shaderStages[0].pSpecializationInfo = stageSpecialization;
         shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         shaderStages[1].module = fragShaderModule;
         shaderStages[1].pName = "main";
         shaderStages[1].flags = 0;
         shaderStages[1].pNext = nullptr;
-        shaderStages[1].pSpecializationInfo = nullptr;
+        shaderStages[1].pSpecializationInfo = stageSpecialization;
 
-        auto bindingDescriptions = LveModel::Vertex::getBindingDescriptions();
-        auto attributeDescriptions = LveModel::Vertex::getAttributeDescriptions();
+        auto bindingDescriptions = LveModel::getBindingDescriptions(configInfo.vertexFormat);
+        auto attributeDescriptions = LveModel::getAttributeDescriptions(configInfo.vertexFormat);
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
         vertexInputInfo.vertexAttributeDescriptionCount =
@@ -98,7 +85,7 @@ namespace lve
         pipelineInfo.basePipelineIndex = -1;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-        if (vkCreateGraphicsPipelines(lveDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+        if (vkCreateGraphicsPipelines(lveDevice.device(), lveDevice.pipelineCache(), 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
         {
             throw std::runtime_error("Failed to create graphics pipeline");
         }
@@ -106,17 +93,41 @@ namespace lve
 
     }
 
-    void vePipeline::creatShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
+    void vePipeline::setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, uint32_t value)
     {
-        VkShaderModuleCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-        if (vkCreateShaderModule(lveDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS)
+        for (const auto& entry : configInfo.specializationMapEntries)
         {
-            throw std::runtime_error("Failed to create shader module");
+            if (entry.constantID == constantId)
+            {
+                configInfo.specializationData[entry.offset / sizeof(uint32_t)] = value;
+                return;
+            }
         }
+
+        VkSpecializationMapEntry entry{};
+        entry.constantID = constantId;
+        entry.offset = static_cast<uint32_t>(configInfo.specializationData.size() * sizeof(uint32_t));
+        entry.size = sizeof(uint32_t);
+        configInfo.specializationMapEntries.push_back(entry);
+        configInfo.specializationData.push_back(value);
+    }
+
+    void vePipeline::setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, int32_t value)
+    {
+        setSpecializationConstant(configInfo, constantId, static_cast<uint32_t>(value));
+    }
+
+    void vePipeline::setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        setSpecializationConstant(configInfo, constantId, bits);
+    }
+
+    void vePipeline::setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, bool value)
+    {
+        // SPIR-V booleans are specialized through a 32-bit VkBool32
+        setSpecializationConstant(configInfo, constantId, static_cast<uint32_t>(value ? VK_TRUE : VK_FALSE));
     }
 
     void vePipeline::bind(VkCommandBuffer CommandBuffer)
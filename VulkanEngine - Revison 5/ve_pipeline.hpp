@@ -1,8 +1,10 @@
 #pragma once 
 
 #include "ve_device.hpp"
+#include "ve_model.hpp"
 
 
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -25,6 +27,12 @@ namespace lve
         VkPipelineLayout pipelineLayout = nullptr;
         VkRenderPass renderPass = nullptr;
         uint32_t subpass = 0;
+        // Specialization constants for both shader stages, one 32-bit word each; set them with
+        // vePipeline::setSpecializationConstant. A stage ignores IDs its shader does not declare.
+        std::vector<VkSpecializationMapEntry> specializationMapEntries;
+        std::vector<uint32_t> specializationData;
+        // Vertex layout of the meshes drawn with the pipeline; see LveModel::VertexFormat
+        LveModel::VertexFormat vertexFormat = LveModel::VertexFormat::FLOAT32;
     };
 
     class vePipeline
@@ -38,18 +46,27 @@ namespace lve
 
         void bind(VkCommandBuffer commandBuffer);
 
+        // Unique per pipeline and never 0, which render queue keys use for "no pipeline"
+        uint32_t getId() const { return id; }
+
         static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
+        // Sets (or replaces) the value of a shader's layout(constant_id = constantId) constant
+        static void setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, uint32_t value);
+        static void setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, int32_t value);
+        static void setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, float value);
+        static void setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, bool value);
+
         private:
-            static std::vector<char> readFile(const std::string& filePath);
-            
             void createGraphicsPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo);
 
-        void creatShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
-
         
+        static std::atomic<uint32_t> nextId;
+
         LveDevice& lveDevice;
+        const uint32_t id = nextId++;
         VkPipeline graphicsPipeline;
+        // Owned by the device's shader module cache and shared with other pipelines
         VkShaderModule vertShaderModule;
         VkShaderModule fragShaderModule;
     };
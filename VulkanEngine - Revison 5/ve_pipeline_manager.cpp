@@ -0,0 +1,264 @@
+#include "ve_pipeline_manager.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+
+// PipelineConfigInfo is not copyable because two of its members point at others; copy the values
+// and re-point those into the new object
+void copyPipelineConfigInfo(const PipelineConfigInfo &source, PipelineConfigInfo &target) {
+  target.viewportInfo = source.viewportInfo;
+  target.inputAssemblyInfo = source.inputAssemblyInfo;
+  target.rasterizationInfo = source.rasterizationInfo;
+  target.multisampleInfo = source.multisampleInfo;
+  target.colorBlendAttachment = source.colorBlendAttachment;
+  target.colorBlendInfo = source.colorBlendInfo;
+  target.depthStencilInfo = source.depthStencilInfo;
+  target.dynamicStateEnables = source.dynamicStateEnables;
+  target.dynamicStateInfo = source.dynamicStateInfo;
+  target.pipelineLayout = source.pipelineLayout;
+  target.renderPass = source.renderPass;
+  target.subpass = source.subpass;
+  target.specializationMapEntries = source.specializationMapEntries;
+  target.specializationData = source.specializationData;
+  target.vertexFormat = source.vertexFormat;
+
+  if (source.colorBlendInfo.pAttachments == &source.colorBlendAttachment) {
+    target.colorBlendInfo.pAttachments = &target.colorBlendAttachment;
+  }
+  if (source.dynamicStateInfo.pDynamicStates == source.dynamicStateEnables.data()) {
+    target.dynamicStateInfo.pDynamicStates = target.dynamicStateEnables.data();
+  }
+}
+
+// Writes every fixed-function value the pipeline is built from, so configs that differ anywhere
+// get different permutation keys. Floats are written in hex so no digits are lost.
+void appendFixedFunctionState(std::ostringstream &key, const PipelineConfigInfo &configInfo) {
+  key << std::hexfloat;
+
+  const auto &viewport = configInfo.viewportInfo;
+  key << "|vp" << viewport.viewportCount << ',' << viewport.scissorCount;
+  if (viewport.pViewports != nullptr) {
+    for (uint32_t i = 0; i < viewport.viewportCount; i++) {
+      const auto &v = viewport.pViewports[i];
+      key << ',' << v.x << ',' << v.y << ',' << v.width << ',' << v.height << ',' << v.minDepth
+          << ',' << v.maxDepth;
+    }
+  }
+  if (viewport.pScissors != nullptr) {
+    for (uint32_t i = 0; i < viewport.scissorCount; i++) {
+      const auto &s = viewport.pScissors[i];
+      key << ',' << s.offset.x << ',' << s.offset.y << ',' << s.extent.width << ','
+          << s.extent.height;
+    }
+  }
+
+  const auto &inputAssembly = configInfo.inputAssemblyInfo;
+  key << "|ia" << inputAssembly.topology << ',' << inputAssembly.primitiveRestartEnable;
+
+  const auto &raster = configInfo.rasterizationInfo;
+  key << "|rs" << raster.depthClampEnable << ',' << raster.rasterizerDiscardEnable << ','
+      << raster.polygonMode << ',' << raster.cullMode << ',' << raster.frontFace << ','
+      << raster.depthBiasEnable << ',' << raster.depthBiasConstantFactor << ','
+      << raster.depthBiasClamp << ',' << raster.depthBiasSlopeFactor << ',' << raster.lineWidth;
+
+  const auto &multisample = configInfo.multisampleInfo;
+  key << "|ms" << multisample.rasterizationSamples << ',' << multisample.sampleShadingEnable << ','
+      << multisample.minSampleShading << ',' << multisample.alphaToCoverageEnable << ','
+      << multisample.alphaToOneEnable;
+  if (multisample.pSampleMask != nullptr) {
+    key << ',' << multisample.pSampleMask[0];
+  }
+
+  const auto &colorBlend = configInfo.colorBlendInfo;
+  key << "|cb" << colorBlend.logicOpEnable << ',' << colorBlend.logicOp << ','
+      << colorBlend.blendConstants[0] << ',' << colorBlend.blendConstants[1] << ','
+      << colorBlend.blendConstants[2] << ',' << colorBlend.blendConstants[3];
+  for (uint32_t i = 0; i < colorBlend.attachmentCount; i++) {
+    const auto &attachment = colorBlend.pAttachments[i];
+    key << ',' << attachment.blendEnable << ',' << attachment.srcColorBlendFactor << ','
+        << attachment.dstColorBlendFactor << ',' << attachment.colorBlendOp << ','
+        << attachment.srcAlphaBlendFactor << ',' << attachment.dstAlphaBlendFactor << ','
+        << attachment.alphaBlendOp << ',' << attachment.colorWriteMask;
+  }
+
+  const auto &depthStencil = configInfo.depthStencilInfo;
+  key << "|ds" << depthStencil.depthTestEnable << ',' << depthStencil.depthWriteEnable << ','
+      << depthStencil.depthCompareOp << ',' << depthStencil.depthBoundsTestEnable << ','
+      << depthStencil.minDepthBounds << ',' << depthStencil.maxDepthBounds << ','
+      << depthStencil.stencilTestEnable;
+  for (const auto *stencil : {&depthStencil.front, &depthStencil.back}) {
+    key << ',' << stencil->failOp << ',' << stencil->passOp << ',' << stencil->depthFailOp << ','
+        << stencil->compareOp << ',' << stencil->compareMask << ',' << stencil->writeMask << ','
+        << stencil->reference;
+  }
+
+  const auto &dynamicState = configInfo.dynamicStateInfo;
+  key << "|dy";
+  for (uint32_t i = 0; i < dynamicState.dynamicStateCount; i++) {
+    key << ',' << dynamicState.pDynamicStates[i];
+  }
+
+  key << std::defaultfloat;
+}
+
+}  // namespace
+
+LvePipelineManager::LvePipelineManager(LveDevice &device, uint32_t threadCount)
+    : lveDevice{device}, compileThreads{threadCount} {
+  // Handle 0 is INVALID_HANDLE
+  requests.emplace_back();
+  requests.back().released = true;
+}
+
+LvePipelineManager::~LvePipelineManager() { waitIdle(); }
+
+LvePipelineManager::Handle LvePipelineManager::request(
+    const std::string &vertFilepath,
+    const std::string &fragFilepath,
+    const PipelineConfigInfo &configInfo) {
+  Request request{};
+  request.configInfo.reset(new PipelineConfigInfo{});
+  copyPipelineConfigInfo(configInfo, *request.configInfo);
+
+  LveDevice *device = &lveDevice;
+  const PipelineConfigInfo *workerConfig = request.configInfo.get();
+  request.compiled = compileThreads.submit([device, vertFilepath, fragFilepath, workerConfig]() {
+    return std::make_unique<vePipeline>(*device, vertFilepath, fragFilepath, *workerConfig);
+  });
+
+  Handle handle;
+  if (!freeHandles.empty()) {
+    handle = freeHandles.back();
+    freeHandles.pop_back();
+    requests[handle] = std::move(request);
+  } else {
+    handle = static_cast<Handle>(requests.size());
+    requests.push_back(std::move(request));
+  }
+  return handle;
+}
+
+LvePipelineManager::Handle LvePipelineManager::requestPermutation(
+    const std::string &vertFilepath,
+    const std::string &fragFilepath,
+    const PipelineConfigInfo &configInfo) {
+  std::string key = makePermutationKey(vertFilepath, fragFilepath, configInfo);
+  auto existing = permutations.find(key);
+  if (existing != permutations.end()) {
+    return existing->second;
+  }
+
+  Handle handle = request(vertFilepath, fragFilepath, configInfo);
+  requests[handle].permutationKey = key;
+  permutations.emplace(std::move(key), handle);
+  return handle;
+}
+
+vePipeline *LvePipelineManager::get(Handle handle) {
+  Request &request = getRequest(handle);
+  if (request.pipeline == nullptr && request.compiled.valid() &&
+      request.compiled.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+    takeCompiled(request);
+  }
+  return request.pipeline.get();
+}
+
+vePipeline *LvePipelineManager::get(Handle handle, vePipeline *fallback) {
+  vePipeline *pipeline = get(handle);
+  return pipeline != nullptr ? pipeline : fallback;
+}
+
+vePipeline &LvePipelineManager::wait(Handle handle) {
+  Request &request = getRequest(handle);
+  if (request.pipeline == nullptr) {
+    if (!request.compiled.valid()) {
+      throw std::runtime_error("failed to compile pipeline!");
+    }
+    takeCompiled(request);
+  }
+  return *request.pipeline;
+}
+
+void LvePipelineManager::release(Handle handle) {
+  Request &request = getRequest(handle);
+  if (request.compiled.valid()) {
+    // A failed compile has nothing to retire; its error is dropped along with the handle
+    try {
+      takeCompiled(request);
+    } catch (const std::exception &) {
+    }
+  }
+  // Frames in flight may still be drawing with it
+  lveDevice.deletionQueue().retire(std::move(request.pipeline));
+  if (!request.permutationKey.empty()) {
+    permutations.erase(request.permutationKey);
+    request.permutationKey.clear();
+  }
+  request.released = true;
+  freeHandles.push_back(handle);
+}
+
+void LvePipelineManager::waitIdle() {
+  for (auto &request : requests) {
+    if (request.compiled.valid()) {
+      request.compiled.wait();
+    }
+  }
+}
+
+uint32_t LvePipelineManager::getPendingCount() const {
+  uint32_t pendingCount = 0;
+  for (const auto &request : requests) {
+    if (request.compiled.valid() &&
+        request.compiled.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      pendingCount++;
+    }
+  }
+  return pendingCount;
+}
+
+void LvePipelineManager::takeCompiled(Request &request) {
+  // The worker is done with the config once the future is ready. get() spends the future either
+  // way, so a failed compile throws only once and then stays nullptr.
+  request.compiled.wait();
+  request.configInfo.reset();
+  request.pipeline = request.compiled.get();
+}
+
+std::string LvePipelineManager::makePermutationKey(
+    const std::string &vertFilepath,
+    const std::string &fragFilepath,
+    const PipelineConfigInfo &configInfo) {
+  // Only built when a permutation is requested, never per frame, so a readable string will do
+  std::ostringstream key;
+  key << vertFilepath << '|' << fragFilepath << '|' << configInfo.pipelineLayout << '|'
+      << configInfo.renderPass << '|' << configInfo.subpass << '|'
+      << static_cast<uint32_t>(configInfo.vertexFormat);
+  appendFixedFunctionState(key, configInfo);
+  // Sorted so the order the constants were set in does not matter
+  std::vector<std::pair<uint32_t, uint32_t>> constants;
+  for (const auto &entry : configInfo.specializationMapEntries) {
+    constants.emplace_back(
+        entry.constantID, configInfo.specializationData[entry.offset / sizeof(uint32_t)]);
+  }
+  std::sort(constants.begin(), constants.end());
+  for (const auto &constant : constants) {
+    key << '|' << constant.first << '=' << constant.second;
+  }
+  return key.str();
+}
+
+LvePipelineManager::Request &LvePipelineManager::getRequest(Handle handle) {
+  assert(handle < requests.size() && !requests[handle].released && "Invalid pipeline handle");
+  return requests[handle];
+}
+
+}  // namespace lve
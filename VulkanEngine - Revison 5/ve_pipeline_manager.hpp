@@ -0,0 +1,91 @@
+#pragma once
+
+#include "ve_device.hpp"
+#include "ve_pipeline.hpp"
+#include "ve_thread_pool.hpp"
+
+// std
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+// Compiles pipelines on background threads so that creating one never stalls a frame. request()
+// returns a handle straight away; get() hands back the pipeline once it is ready and nullptr until
+// then, so callers can skip those draws or fall back to another pipeline in the meantime. All
+// compiles share the device's pipeline cache. Handles are used from one thread only.
+class LvePipelineManager {
+ public:
+  using Handle = uint32_t;
+  static constexpr Handle INVALID_HANDLE = 0;
+
+  // Compiles run on their own workers rather than the frame recording pool, so a long compile
+  // cannot delay the secondaries a frame is waiting for
+  LvePipelineManager(LveDevice &device, uint32_t threadCount = 1);
+  ~LvePipelineManager();
+
+  LvePipelineManager(const LvePipelineManager &) = delete;
+  LvePipelineManager &operator=(const LvePipelineManager &) = delete;
+
+  // Queues a compile. configInfo is copied, but the layout and render pass it names must stay
+  // alive until the pipeline is ready.
+  Handle request(
+      const std::string &vertFilepath,
+      const std::string &fragFilepath,
+      const PipelineConfigInfo &configInfo);
+
+  // Like request(), but each distinct combination of shaders and pipeline config (fixed-function
+  // state, specialization constants, layout, render pass and subpass) is compiled only once:
+  // asking for it again returns the same handle until that handle is released
+  Handle requestPermutation(
+      const std::string &vertFilepath,
+      const std::string &fragFilepath,
+      const PipelineConfigInfo &configInfo);
+
+  // The compiled pipeline, or nullptr while it is still compiling. Never blocks; rethrows the
+  // error if compilation failed.
+  vePipeline *get(Handle handle);
+  // get(), or fallback while the pipeline is not ready
+  vePipeline *get(Handle handle, vePipeline *fallback);
+  // Blocks until the pipeline is compiled
+  vePipeline &wait(Handle handle);
+  // Retires the pipeline through the device's deletion queue, waiting for the compile if needed.
+  // The handle is invalid afterwards and may be handed out again by a later request.
+  void release(Handle handle);
+  // Blocks until every queued compile has finished, e.g. before destroying the layouts they use
+  void waitIdle();
+
+  uint32_t getPendingCount() const;
+  uint32_t getPermutationCount() const { return static_cast<uint32_t>(permutations.size()); }
+
+ private:
+  struct Request {
+    // Heap-allocated so its internal pointers stay valid while the worker reads it
+    std::unique_ptr<PipelineConfigInfo> configInfo;
+    std::future<std::unique_ptr<vePipeline>> compiled;
+    std::unique_ptr<vePipeline> pipeline;
+    // Key in permutations, empty for plain requests
+    std::string permutationKey;
+    bool released = false;
+  };
+
+  static std::string makePermutationKey(
+      const std::string &vertFilepath,
+      const std::string &fragFilepath,
+      const PipelineConfigInfo &configInfo);
+
+  void takeCompiled(Request &request);
+  Request &getRequest(Handle handle);
+
+  LveDevice &lveDevice;
+  std::vector<Request> requests;
+  std::vector<Handle> freeHandles;
+  std::unordered_map<std::string, Handle> permutations;
+  // Declared last so its workers are joined before the requests they use are destroyed
+  LveThreadPool compileThreads;
+};
+
+}  // namespace lve
@@ -0,0 +1,49 @@
+#include "ve_render_queue.hpp"
+
+// std
+#include <array>
+
+namespace lve {
+
+uint64_t LveRenderQueue::makeKey(uint32_t pipelineId, uint32_t modelId, uint32_t depthBucket) {
+  const uint64_t pipelineMask = (1ull << PIPELINE_BITS) - 1;
+  const uint64_t modelMask = (1ull << MODEL_BITS) - 1;
+  const uint64_t depthMask = (1ull << DEPTH_BITS) - 1;
+  return ((pipelineId & pipelineMask) << (MODEL_BITS + DEPTH_BITS)) |
+         ((modelId & modelMask) << DEPTH_BITS) | (depthBucket & depthMask);
+}
+
+void LveRenderQueue::sort() {
+  if (packets.size() < 2) return;
+
+  // Histogram all eight bytes in one pass over the keys
+  std::array<std::array<uint32_t, 256>, 8> counts{};
+  for (const auto &packet : packets) {
+    for (uint32_t byte = 0; byte < 8; byte++) {
+      counts[byte][(packet.key >> (byte * 8)) & 0xff]++;
+    }
+  }
+
+  scratch.resize(packets.size());
+  const uint32_t packetCount = static_cast<uint32_t>(packets.size());
+  for (uint32_t byte = 0; byte < 8; byte++) {
+    auto &histogram = counts[byte];
+
+    // All keys share this byte (e.g. a single pipeline): the pass would not move anything
+    if (histogram[(packets[0].key >> (byte * 8)) & 0xff] == packetCount) continue;
+
+    uint32_t offset = 0;
+    for (auto &count : histogram) {
+      uint32_t bucketSize = count;
+      count = offset;
+      offset += bucketSize;
+    }
+
+    for (const auto &packet : packets) {
+      scratch[histogram[(packet.key >> (byte * 8)) & 0xff]++] = packet;
+    }
+    packets.swap(scratch);
+  }
+}
+
+}  // namespace lve
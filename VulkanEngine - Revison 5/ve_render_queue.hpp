@@ -0,0 +1,49 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// Collects draw packets tagged with a 64-bit sort key and orders them with an LSD radix sort, so
+// that packets sharing a pipeline, then a model, end up adjacent and state changes can be skipped.
+//
+// Key layout, most significant first:
+//   [63..48] pipeline id   [47..24] model id   [23..0] depth bucket
+class LveRenderQueue {
+ public:
+  static constexpr uint32_t PIPELINE_BITS = 16;
+  static constexpr uint32_t MODEL_BITS = 24;
+  static constexpr uint32_t DEPTH_BITS = 24;
+
+  struct Packet {
+    uint64_t key;
+    // Caller-defined payload, typically an index into the caller's own draw data
+    uint32_t index;
+  };
+
+  static uint64_t makeKey(uint32_t pipelineId, uint32_t modelId, uint32_t depthBucket);
+  static uint32_t getPipelineId(uint64_t key) {
+    return static_cast<uint32_t>(key >> (MODEL_BITS + DEPTH_BITS));
+  }
+  static uint32_t getModelId(uint64_t key) {
+    return static_cast<uint32_t>(key >> DEPTH_BITS) & ((1u << MODEL_BITS) - 1);
+  }
+
+  void clear() { packets.clear(); }
+  void push(uint64_t key, uint32_t index) { packets.push_back({key, index}); }
+
+  // Stable sort by key; byte positions where every key agrees are skipped
+  void sort();
+
+  const std::vector<Packet> &getPackets() const { return packets; }
+  size_t size() const { return packets.size(); }
+
+ private:
+  std::vector<Packet> packets;
+  std::vector<Packet> scratch;
+};
+
+}  // namespace lve
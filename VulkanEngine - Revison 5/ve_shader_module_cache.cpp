@@ -0,0 +1,193 @@
+#include "ve_shader_module_cache.hpp"
+
+// std
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lve {
+
+namespace {
+
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+// Read-only view of a whole file. Mappings are page aligned, which satisfies the 4-byte alignment
+// VkShaderModuleCreateInfo::pCode needs.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string &filepath) {
+#ifdef _WIN32
+    file = CreateFileA(
+        filepath.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      throw std::runtime_error("failed to open file: " + filepath);
+    }
+    LARGE_INTEGER fileSize{};
+    GetFileSizeEx(file, &fileSize);
+    size = static_cast<size_t>(fileSize.QuadPart);
+    if (size == 0) return;
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping != nullptr) {
+      data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    descriptor = open(filepath.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+      throw std::runtime_error("failed to open file: " + filepath);
+    }
+    struct stat fileStat {};
+    fstat(descriptor, &fileStat);
+    size = static_cast<size_t>(fileStat.st_size);
+    if (size == 0) return;
+
+    void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    data = view != MAP_FAILED ? view : nullptr;
+#endif
+    if (data == nullptr) {
+      close();
+      throw std::runtime_error("failed to map file: " + filepath);
+    }
+  }
+
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const void *getData() const { return data; }
+  size_t getSize() const { return size; }
+
+ private:
+  void close() {
+#ifdef _WIN32
+    if (data != nullptr) UnmapViewOfFile(data);
+    if (mapping != nullptr) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (data != nullptr) munmap(data, size);
+    if (descriptor >= 0) ::close(descriptor);
+    descriptor = -1;
+#endif
+    data = nullptr;
+  }
+
+#ifdef _WIN32
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = nullptr;
+#else
+  int descriptor = -1;
+#endif
+  void *data = nullptr;
+  size_t size = 0;
+};
+
+}  // namespace
+
+LveShaderModuleCache::LveShaderModuleCache(VkDevice device) : device{device} {}
+
+LveShaderModuleCache::~LveShaderModuleCache() {
+  for (auto &kv : modules) {
+    for (auto &entry : kv.second) {
+      vkDestroyShaderModule(device, entry.module, nullptr);
+    }
+  }
+}
+
+VkShaderModule LveShaderModuleCache::getModule(const std::string &filepath) {
+  {
+    std::lock_guard<std::mutex> lock{modulesMutex};
+    auto fileModule = fileModules.find(filepath);
+    if (fileModule != fileModules.end()) {
+      stats.hits++;
+      return fileModule->second;
+    }
+  }
+
+  // Mapped and hashed outside the lock so compiles on other threads are not held up by the I/O
+  MappedFile file{filepath};
+  const auto *code = static_cast<const uint32_t *>(file.getData());
+  if (file.getSize() < sizeof(uint32_t) || file.getSize() % sizeof(uint32_t) != 0 ||
+      code[0] != SPIRV_MAGIC) {
+    throw std::runtime_error("invalid SPIR-V file: " + filepath);
+  }
+  ModuleKey key{hashCode(code, file.getSize()), file.getSize()};
+
+  std::lock_guard<std::mutex> lock{modulesMutex};
+  stats.bytesLoaded += file.getSize();
+  VkShaderModule module = findOrCreate(key, code);
+  fileModules.emplace(filepath, module);
+  return module;
+}
+
+VkShaderModule LveShaderModuleCache::getModule(const uint32_t *code, size_t size) {
+  ModuleKey key{hashCode(code, size), size};
+
+  std::lock_guard<std::mutex> lock{modulesMutex};
+  return findOrCreate(key, code);
+}
+
+LveShaderModuleCache::Stats LveShaderModuleCache::getStats() const {
+  std::lock_guard<std::mutex> lock{modulesMutex};
+  Stats result = stats;
+  for (const auto &kv : modules) {
+    result.moduleCount += static_cast<uint32_t>(kv.second.size());
+  }
+  return result;
+}
+
+uint64_t LveShaderModuleCache::hashCode(const uint32_t *code, size_t size) {
+  // FNV-1a over whole words; SPIR-V is always a multiple of four bytes
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
+    hash ^= code[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+VkShaderModule LveShaderModuleCache::findOrCreate(const ModuleKey &key, const uint32_t *code) {
+  auto &entries = modules[key];
+  for (const auto &entry : entries) {
+    if (std::memcmp(entry.code.data(), code, key.size) == 0) {
+      stats.hits++;
+      return entry.module;
+    }
+  }
+
+  VkShaderModuleCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = key.size;
+  createInfo.pCode = code;
+
+  VkShaderModule module;
+  if (vkCreateShaderModule(device, &createInfo, nullptr, &module) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shader module!");
+  }
+  stats.misses++;
+  std::vector<uint32_t> codeCopy(code, code + key.size / sizeof(uint32_t));
+  entries.push_back(Module{std::move(codeCopy), module});
+  return module;
+}
+
+}  // namespace lve
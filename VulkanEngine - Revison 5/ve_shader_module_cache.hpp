@@ -0,0 +1,77 @@
+#pragma once
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+// Device-wide registry of shader modules keyed by a hash of their SPIR-V, so every pipeline built
+// from the same bytecode shares one VkShaderModule. Each module keeps a copy of its bytecode and a
+// hash match only counts once the bytes compare equal, so a collision cannot return the wrong
+// module. Files are memory-mapped rather than copied through a stream, and a file path seen
+// before is answered without touching the file again. Modules live as long as the cache.
+// Thread-safe, so pipelines can be compiled on worker threads.
+class LveShaderModuleCache {
+ public:
+  struct Stats {
+    // Requests answered with an existing module
+    uint32_t hits = 0;
+    // Requests that created a module
+    uint32_t misses = 0;
+    uint32_t moduleCount = 0;
+    // SPIR-V bytes read from disk
+    uint64_t bytesLoaded = 0;
+  };
+
+  explicit LveShaderModuleCache(VkDevice device);
+  ~LveShaderModuleCache();
+
+  LveShaderModuleCache(const LveShaderModuleCache &) = delete;
+  LveShaderModuleCache &operator=(const LveShaderModuleCache &) = delete;
+
+  // The module for a SPIR-V file. Files are assumed not to change while the program runs.
+  VkShaderModule getModule(const std::string &filepath);
+  // The module for SPIR-V already in memory; size is in bytes
+  VkShaderModule getModule(const uint32_t *code, size_t size);
+
+  Stats getStats() const;
+
+ private:
+  struct ModuleKey {
+    uint64_t hash;
+    size_t size;
+    bool operator==(const ModuleKey &other) const {
+      return hash == other.hash && size == other.size;
+    }
+  };
+  struct ModuleKeyHash {
+    size_t operator()(const ModuleKey &key) const {
+      return static_cast<size_t>(key.hash ^ (key.size * 0x9e3779b97f4a7c15ull));
+    }
+  };
+
+  struct Module {
+    std::vector<uint32_t> code;
+    VkShaderModule module;
+  };
+
+  static uint64_t hashCode(const uint32_t *code, size_t size);
+  // Expects modulesMutex to be held
+  VkShaderModule findOrCreate(const ModuleKey &key, const uint32_t *code);
+
+  VkDevice device;
+  mutable std::mutex modulesMutex;
+  // Almost always one module per key; more only when different bytecode collides
+  std::unordered_map<ModuleKey, std::vector<Module>, ModuleKeyHash> modules;
+  std::unordered_map<std::string, VkShaderModule> fileModules;
+  Stats stats{};
+};
+
+}  // namespace lve
@@ -0,0 +1,94 @@
+#include "ve_static_command_cache.hpp"
+
+#include "ve_swap_chain.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+LveStaticCommandCache::LveStaticCommandCache(LveDevice &device) : lveDevice{device} {
+  QueueFamilyIndices queueFamilyIndices = lveDevice.findPhysicalQueueFamilies();
+
+  // Not transient: these buffers live for many frames and are reset one at a time
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+  if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create static command pool!");
+  }
+
+  std::vector<VkCommandBuffer> commandBuffers(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+  allocInfo.commandPool = commandPool;
+  allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+  if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, commandBuffers.data()) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate static command buffers!");
+  }
+
+  frameCommands.resize(commandBuffers.size());
+  for (size_t i = 0; i < commandBuffers.size(); i++) {
+    frameCommands[i].commandBuffer = commandBuffers[i];
+  }
+}
+
+LveStaticCommandCache::~LveStaticCommandCache() {
+  // Destroying the pool frees the command buffers allocated from it
+  vkDestroyCommandPool(lveDevice.device(), commandPool, nullptr);
+}
+
+void LveStaticCommandCache::invalidate() {
+  for (auto &commands : frameCommands) {
+    commands.valid = false;
+  }
+}
+
+VkCommandBuffer LveStaticCommandCache::get(
+    int frameIndex, uint64_t sceneGeneration, VkRenderPass renderPass, const RecordFn &recordFn) {
+  assert(frameIndex >= 0 && frameIndex < LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+  CachedCommands &commands = frameCommands[frameIndex];
+  if (commands.valid && commands.sceneGeneration == sceneGeneration) {
+    return commands.commandBuffer;
+  }
+
+  // The frame's fence has been waited on, so the previous recording is no longer pending
+  vkResetCommandBuffer(commands.commandBuffer, 0);
+
+  // A null framebuffer lets the same recording run inside whichever swap chain image's framebuffer
+  // the frame slot ends up rendering to
+  VkCommandBufferInheritanceInfo inheritanceInfo{};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = renderPass;
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  if (vkBeginCommandBuffer(commands.commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording static command buffer!");
+  }
+
+  recordFn(commands.commandBuffer, frameIndex);
+
+  if (vkEndCommandBuffer(commands.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record static command buffer!");
+  }
+
+  commands.sceneGeneration = sceneGeneration;
+  commands.valid = true;
+  recordCount++;
+  return commands.commandBuffer;
+}
+
+}  // namespace lve
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ve_device.hpp"
+
+// std
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace lve {
+
+// Keeps one pre-recorded secondary command buffer per frame in flight for content that rarely
+// changes. A buffer is only re-recorded when the caller's scene generation moves past the one it
+// was recorded for, or after invalidate(); every other frame just executes it again, so a frame in
+// which only the camera moves (camera data lives in a uniform buffer) records almost nothing.
+class LveStaticCommandCache {
+ public:
+  // Records the static content for frameIndex. Dynamic state and bindings are not inherited from
+  // the primary, so the callback must set them up itself.
+  using RecordFn = std::function<void(VkCommandBuffer commandBuffer, int frameIndex)>;
+
+  LveStaticCommandCache(LveDevice &device);
+  ~LveStaticCommandCache();
+
+  LveStaticCommandCache(const LveStaticCommandCache &) = delete;
+  LveStaticCommandCache &operator=(const LveStaticCommandCache &) = delete;
+
+  // Drops every recording; call after the swap chain is recreated, since the render pass, extent
+  // and pipelines baked into the buffers may all have changed
+  void invalidate();
+
+  // Returns frameIndex's secondary, re-recording it first if it is stale. The buffer continues
+  // renderPass from any framebuffer. Only call once frameIndex's fence has been waited on.
+  VkCommandBuffer get(
+      int frameIndex, uint64_t sceneGeneration, VkRenderPass renderPass, const RecordFn &recordFn);
+
+  // Number of times any buffer has been (re-)recorded
+  uint32_t getRecordCount() const { return recordCount; }
+
+ private:
+  struct CachedCommands {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    uint64_t sceneGeneration = 0;
+    bool valid = false;
+  };
+
+  LveDevice &lveDevice;
+  VkCommandPool commandPool = VK_NULL_HANDLE;
+  std::vector<CachedCommands> frameCommands;
+  uint32_t recordCount = 0;
+};
+
+}  // namespace lve
@@ -1,6 +1,9 @@
 #include "ve_swap_chain.hpp"
+#include "ve_cpu_profiler.hpp"
+#include "ve_upload_manager.hpp"
 
 // std
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
@@ -11,8 +14,9 @@
 
 namespace lve {
 
-LveSwapChain::LveSwapChain(LveDevice &deviceRef, VkExtent2D extent)
-    : device{deviceRef}, windowExtent{extent} {
+LveSwapChain::LveSwapChain(LveDevice &deviceRef, VkExtent2D extent, const Config &config)
+    : device{deviceRef}, windowExtent{extent}, config{config} {
+  this->config.framesInFlight = std::max(1, std::min(config.framesInFlight, MAX_FRAMES_IN_FLIGHT));
   createSwapChain();
   createImageViews();
   createRenderPass();
@@ -21,17 +25,24 @@ LveSwapChain::LveSwapChain(LveDevice &deviceRef, VkExtent2D extent)
   createSyncObjects();
 }
 
-LveSwapChain::LveSwapChain(LveDevice &deviceRef, VkExtent2D extent, std::unique_ptr<LveSwapChain> previous)
-    : device{deviceRef}, windowExtent{extent}, oldSwapChain{previous.release()} {
+LveSwapChain::LveSwapChain(
+    LveDevice &deviceRef,
+    VkExtent2D extent,
+    std::unique_ptr<LveSwapChain> previous,
+    const Config &config)
+    : device{deviceRef}, windowExtent{extent}, config{config}, oldSwapChain{previous.release()} {
+  this->config.framesInFlight = std::max(1, std::min(config.framesInFlight, MAX_FRAMES_IN_FLIGHT));
   createSwapChain();
   createImageViews();
   createRenderPass();
   createDepthResources();
   createFramebuffers();
   createSyncObjects();
+  takeOverFrameSlots(*oldSwapChain);
 
-  // cleanup old swap chain since we now own it
-  delete oldSwapChain;
+  // The old swap chain's images may still be rendered to or presented, so it is destroyed only
+  // once every frame submitted so far has completed
+  device.deletionQueue().retire(std::unique_ptr<LveSwapChain>(oldSwapChain));
   oldSwapChain = nullptr;
 }
 
@@ -49,7 +60,7 @@ LveSwapChain::~LveSwapChain() {
   for (int i = 0; i < depthImages.size(); i++) {
     vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
     vkDestroyImage(device.device(), depthImages[i], nullptr);
-    vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+    device.memoryAllocator().free(depthImageAllocations[i]);
   }
 
   for (auto framebuffer : swapChainFramebuffers) {
@@ -62,17 +73,31 @@ LveSwapChain::~LveSwapChain() {
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
     vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-    vkDestroyFence(device.device(), inFlightFences[i], nullptr);
+  }
+  for (auto fence : inFlightFences) {
+    vkDestroyFence(device.device(), fence, nullptr);
   }
 }
 
 VkResult LveSwapChain::acquireNextImage(uint32_t *imageIndex) {
-  vkWaitForFences(
-      device.device(),
-      1,
-      &inFlightFences[currentFrame],
-      VK_TRUE,
-      std::numeric_limits<uint64_t>::max());
+  LVE_PROFILE_ZONE("acquireNextImage");
+  {
+    LVE_PROFILE_ZONE("wait for frame slot");
+    if (config.frameTimeline != nullptr) {
+      config.frameTimeline->wait(frameTimelineValues[currentFrame]);
+    } else {
+      vkWaitForFences(
+          device.device(),
+          1,
+          &inFlightFences[currentFrame],
+          VK_TRUE,
+          std::numeric_limits<uint64_t>::max());
+    }
+  }
+
+  // Submissions to one queue complete in order, so every frame up to this slot's has finished
+  completedFrameCount = std::max(completedFrameCount, frameNumbers[currentFrame]);
+  device.deletionQueue().collect(completedFrameCount);
 
   VkResult result = vkAcquireNextImageKHR(
       device.device(),
@@ -86,7 +111,18 @@ VkResult LveSwapChain::acquireNextImage(uint32_t *imageIndex) {
 }
 
 VkResult LveSwapChain::submitCommandBuffers(
-    const VkCommandBuffer *buffers, uint32_t *imageIndex) {
+    const VkCommandBuffer *buffers, uint32_t *imageIndex, uint32_t bufferCount) {
+  // Copies queued while building the frame go first, so it sees their data
+  device.uploadManager().flush();
+
+  frameNumbers[currentFrame] = ++submittedFrameCount;
+  // Anything retired from here on may be used by the next frame
+  device.deletionQueue().setSubmitFrame(submittedFrameCount + 1);
+
+  if (config.frameTimeline != nullptr) {
+    return submitWithTimeline(buffers, imageIndex, bufferCount);
+  }
+
   if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
     vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
   }
@@ -101,7 +137,7 @@ VkResult LveSwapChain::submitCommandBuffers(
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
 
-  submitInfo.commandBufferCount = 1;
+  submitInfo.commandBufferCount = bufferCount;
   submitInfo.pCommandBuffers = buffers;
 
   VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
@@ -128,7 +164,65 @@ VkResult LveSwapChain::submitCommandBuffers(
 
   auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
-  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  currentFrame = (currentFrame + 1) % config.framesInFlight;
+
+  return result;
+}
+
+VkResult LveSwapChain::submitWithTimeline(
+    const VkCommandBuffer *buffers, uint32_t *imageIndex, uint32_t bufferCount) {
+  LveFrameTimeline &timeline = *config.frameTimeline;
+
+  // Usually already reached by the wait in acquireNextImage, in which case this costs no API call
+  timeline.wait(imageTimelineValues[*imageIndex]);
+
+  uint64_t signalValue = timeline.advance();
+  frameTimelineValues[currentFrame] = signalValue;
+  imageTimelineValues[*imageIndex] = signalValue;
+
+  // Presentation only understands binary semaphores, so the frame signals both kinds. The values
+  // paired with binary semaphores are ignored.
+  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
+  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+  uint64_t waitValues[] = {0};
+  VkSemaphore signalSemaphores[] = {
+      renderFinishedSemaphores[currentFrame],
+      timeline.getSemaphore()};
+  uint64_t signalValues[] = {0, signalValue};
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.waitSemaphoreValueCount = 1;
+  timelineInfo.pWaitSemaphoreValues = waitValues;
+  timelineInfo.signalSemaphoreValueCount = 2;
+  timelineInfo.pSignalSemaphoreValues = signalValues;
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = &timelineInfo;
+  submitInfo.waitSemaphoreCount = 1;
+  submitInfo.pWaitSemaphores = waitSemaphores;
+  submitInfo.pWaitDstStageMask = waitStages;
+  submitInfo.commandBufferCount = bufferCount;
+  submitInfo.pCommandBuffers = buffers;
+  submitInfo.signalSemaphoreCount = 2;
+  submitInfo.pSignalSemaphores = signalSemaphores;
+
+  if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit draw command buffer!");
+  }
+
+  VkPresentInfoKHR presentInfo = {};
+  presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+  presentInfo.waitSemaphoreCount = 1;
+  presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
+  presentInfo.swapchainCount = 1;
+  presentInfo.pSwapchains = &swapChain;
+  presentInfo.pImageIndices = imageIndex;
+
+  auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+
+  currentFrame = (currentFrame + 1) % config.framesInFlight;
 
   return result;
 }
@@ -137,10 +231,12 @@ void LveSwapChain::createSwapChain() {
   SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
   VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-  VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+  presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
   VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-  uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+  uint32_t imageCount = config.imageCount > 0 ? config.imageCount
+                                               : swapChainSupport.capabilities.minImageCount + 1;
+  imageCount = std::max(imageCount, swapChainSupport.capabilities.minImageCount);
   if (swapChainSupport.capabilities.maxImageCount > 0 &&
       imageCount > swapChainSupport.capabilities.maxImageCount) {
     imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -303,10 +399,11 @@ void LveSwapChain::createFramebuffers() {
 
 void LveSwapChain::createDepthResources() {
   VkFormat depthFormat = findDepthFormat();
+  swapChainDepthFormat = depthFormat;
   VkExtent2D swapChainExtent = getSwapChainExtent();
 
   depthImages.resize(imageCount());
-  depthImageMemorys.resize(imageCount());
+  depthImageAllocations.resize(imageCount());
   depthImageViews.resize(imageCount());
 
   for (int i = 0; i < depthImages.size(); i++) {
@@ -330,7 +427,7 @@ void LveSwapChain::createDepthResources() {
         imageInfo,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         depthImages[i],
-        depthImageMemorys[i]);
+        depthImageAllocations[i]);
 
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -352,8 +449,15 @@ void LveSwapChain::createDepthResources() {
 void LveSwapChain::createSyncObjects() {
   imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-  imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+  frameNumbers.assign(MAX_FRAMES_IN_FLIGHT, 0);
+  // Timeline mode needs no fences; the timeline values take their place
+  if (config.frameTimeline != nullptr) {
+    frameTimelineValues.assign(MAX_FRAMES_IN_FLIGHT, 0);
+    imageTimelineValues.assign(imageCount(), 0);
+  } else {
+    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+  }
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -366,13 +470,54 @@ void LveSwapChain::createSyncObjects() {
     if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
             VK_SUCCESS ||
         vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
-            VK_SUCCESS ||
+            VK_SUCCESS) {
+      throw std::runtime_error("failed to create synchronization objects for a frame!");
+    }
+    if (!inFlightFences.empty() &&
         vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
       throw std::runtime_error("failed to create synchronization objects for a frame!");
     }
   }
 }
 
+void LveSwapChain::takeOverFrameSlots(LveSwapChain &previous) {
+  submittedFrameCount = previous.submittedFrameCount;
+  completedFrameCount = previous.completedFrameCount;
+  currentFrame = previous.currentFrame % config.framesInFlight;
+
+  if (previous.config.frameTimeline != config.frameTimeline) {
+    // Switching sync modes: the old slots' fences or timeline values mean nothing to this swap
+    // chain, so wait them out once. This only happens when the setting is changed.
+    previous.waitForSubmittedFrames();
+    completedFrameCount = submittedFrameCount;
+    return;
+  }
+
+  // Per-frame resources (command pools, instance and uniform buffers) are indexed by slot, so a
+  // slot must not be reused before the previous swap chain's submission from it has completed
+  frameNumbers = previous.frameNumbers;
+  if (config.frameTimeline != nullptr) {
+    frameTimelineValues = previous.frameTimelineValues;
+  } else {
+    // The previous swap chain destroys the fresh, never-submitted fences in their place
+    std::swap(inFlightFences, previous.inFlightFences);
+  }
+}
+
+void LveSwapChain::waitForSubmittedFrames() {
+  if (config.frameTimeline != nullptr) {
+    config.frameTimeline->wait(
+        *std::max_element(frameTimelineValues.begin(), frameTimelineValues.end()));
+  } else {
+    vkWaitForFences(
+        device.device(),
+        static_cast<uint32_t>(inFlightFences.size()),
+        inFlightFences.data(),
+        VK_TRUE,
+        std::numeric_limits<uint64_t>::max());
+  }
+}
+
 VkSurfaceFormatKHR LveSwapChain::chooseSwapSurfaceFormat(
     const std::vector<VkSurfaceFormatKHR> &availableFormats) {
   for (const auto &availableFormat : availableFormats) {
@@ -388,23 +533,32 @@ VkSurfaceFormatKHR LveSwapChain::chooseSwapSurfaceFormat(
 VkPresentModeKHR LveSwapChain::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> &availablePresentModes) {
   for (const auto &availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      std::cout << "Present mode: Mailbox" << std::endl;
+    if (availablePresentMode == config.presentMode) {
+      std::cout << "Present mode: " << presentModeName(availablePresentMode) << std::endl;
       return availablePresentMode;
     }
   }
 
-  // for (const auto &availablePresentMode : availablePresentModes) {
-  //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-  //     std::cout << "Present mode: Immediate" << std::endl;
-  //     return availablePresentMode;
-  //   }
-  // }
-
-  std::cout << "Present mode: V-Sync" << std::endl;
+  std::cout << "Present mode: " << presentModeName(VK_PRESENT_MODE_FIFO_KHR) << " ("
+            << presentModeName(config.presentMode) << " not supported)" << std::endl;
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+const char *LveSwapChain::presentModeName(VkPresentModeKHR presentMode) {
+  switch (presentMode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+      return "Immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+      return "Mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR:
+      return "V-Sync";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+      return "Relaxed V-Sync";
+    default:
+      return "Unknown";
+  }
+}
+
 VkExtent2D LveSwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities) {
   if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
     return capabilities.currentExtent;
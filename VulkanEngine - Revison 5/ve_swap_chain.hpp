@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ve_device.hpp"
+#include "ve_frame_timeline.hpp"
 
 // vulkan headers
 #include <vulkan/vulkan.h>
@@ -12,12 +13,35 @@
 
 namespace lve {
 
+struct LveSwapChainConfig {
+  // Used when the surface supports it, otherwise FIFO, which every surface supports
+  VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+  // 0 picks minImageCount + 1; anything else is clamped to the surface's limits
+  uint32_t imageCount = 0;
+  // How many frames the CPU may record ahead of the GPU, 1 to MAX_FRAMES_IN_FLIGHT. Fewer means
+  // lower input latency, more means the CPU and GPU overlap better.
+  int framesInFlight = 2;
+  // When set, frames are paced by this timeline instead of per-slot fences, and each submission
+  // signals the timeline's next value. It must outlive the swap chain.
+  LveFrameTimeline *frameTimeline = nullptr;
+};
+
 class LveSwapChain {
  public:
-  static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
-  LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent);
-  LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent, std::unique_ptr<LveSwapChain> previous);
+  // Upper bound for per-frame resources; how many are actually cycled is Config::framesInFlight
+  static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+
+  using Config = LveSwapChainConfig;
+
+  LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent, const Config &config = Config{});
+  // Recreation without idling the device: the new swap chain takes over the previous one's frame
+  // slots, so in-flight frames keep being waited on, and retires it through the device's deletion
+  // queue once the frames that used it have completed
+  LveSwapChain(
+      LveDevice &deviceRef,
+      VkExtent2D windowExtent,
+      std::unique_ptr<LveSwapChain> previous,
+      const Config &config = Config{});
   ~LveSwapChain();
 
   LveSwapChain(const LveSwapChain &) = delete;
@@ -28,6 +52,7 @@ class LveSwapChain {
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
   size_t imageCount() { return swapChainImages.size(); }
   VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
+  VkFormat getSwapChainDepthFormat() { return swapChainDepthFormat; }
   VkExtent2D getSwapChainExtent() { return swapChainExtent; }
   uint32_t width() { return swapChainExtent.width; }
   uint32_t height() { return swapChainExtent.height; }
@@ -36,9 +61,30 @@ class LveSwapChain {
     return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
   }
   VkFormat findDepthFormat();
+  // Render passes with the same attachment formats are compatible, so pipelines built for a swap
+  // chain with these formats can be used with this one
+  bool compareSwapFormats(VkFormat imageFormat, VkFormat depthFormat) const {
+    return swapChainImageFormat == imageFormat && swapChainDepthFormat == depthFormat;
+  }
+
+  const Config &getConfig() const { return config; }
+  int getFramesInFlight() const { return config.framesInFlight; }
+  // The mode actually in use, which can differ from the one requested
+  VkPresentModeKHR getPresentMode() const { return presentMode; }
+  static const char *presentModeName(VkPresentModeKHR presentMode);
+
+  // Index of the frame-in-flight slot being recorded; valid between acquire and submit
+  int getCurrentFrameIndex() const { return static_cast<int>(currentFrame); }
+  // Frames are numbered from 1 in submission order, continuing across recreation. Every frame up
+  // to getCompletedFrameNumber() has finished on the GPU.
+  uint64_t getSubmittedFrameNumber() const { return submittedFrameCount; }
+  uint64_t getCompletedFrameNumber() const { return completedFrameCount; }
 
   VkResult acquireNextImage(uint32_t *imageIndex);
-  VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+  // Submits bufferCount buffers in order as one batch, guarded by the frame slot's fence or, in
+  // timeline mode, by the timeline value it signals
+  VkResult submitCommandBuffers(
+      const VkCommandBuffer *buffers, uint32_t *imageIndex, uint32_t bufferCount = 1);
 
  private:
   void createSwapChain();
@@ -47,6 +93,10 @@ class LveSwapChain {
   void createRenderPass();
   void createFramebuffers();
   void createSyncObjects();
+  void takeOverFrameSlots(LveSwapChain &previous);
+  void waitForSubmittedFrames();
+  VkResult submitWithTimeline(
+      const VkCommandBuffer *buffers, uint32_t *imageIndex, uint32_t bufferCount);
 
   // Helper functions
   VkSurfaceFormatKHR chooseSwapSurfaceFormat(
@@ -56,19 +106,22 @@ class LveSwapChain {
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
 
   VkFormat swapChainImageFormat;
+  VkFormat swapChainDepthFormat;
   VkExtent2D swapChainExtent;
 
   std::vector<VkFramebuffer> swapChainFramebuffers;
   VkRenderPass renderPass;
 
   std::vector<VkImage> depthImages;
-  std::vector<VkDeviceMemory> depthImageMemorys;
+  std::vector<LveAllocation> depthImageAllocations;
   std::vector<VkImageView> depthImageViews;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
 
   LveDevice &device;
   VkExtent2D windowExtent;
+  Config config;
+  VkPresentModeKHR presentMode;
 
   VkSwapchainKHR swapChain;
   LveSwapChain *oldSwapChain = nullptr;
@@ -77,6 +130,13 @@ class LveSwapChain {
   std::vector<VkSemaphore> renderFinishedSemaphores;
   std::vector<VkFence> inFlightFences;
   std::vector<VkFence> imagesInFlight;
+  // Timeline mode: the value last submitted from each frame slot and to each image, 0 if none
+  std::vector<uint64_t> frameTimelineValues;
+  std::vector<uint64_t> imageTimelineValues;
+  // Frame number last submitted from each frame slot, 0 if none
+  std::vector<uint64_t> frameNumbers;
+  uint64_t submittedFrameCount = 0;
+  uint64_t completedFrameCount = 0;
   size_t currentFrame = 0;
 };
 
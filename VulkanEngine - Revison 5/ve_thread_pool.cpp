@@ -0,0 +1,50 @@
+#include "ve_thread_pool.hpp"
+#include "ve_cpu_profiler.hpp"
+
+// std
+#include <algorithm>
+
+namespace lve {
+
+LveThreadPool::LveThreadPool(uint32_t threadCount) {
+  threadCount = std::max(threadCount, 1u);
+  workers.reserve(threadCount);
+  for (uint32_t i = 0; i < threadCount; i++) {
+    workers.emplace_back([this]() { workerLoop(); });
+  }
+}
+
+LveThreadPool::~LveThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{queueMutex};
+    stopping = true;
+  }
+  condition.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+uint32_t LveThreadPool::defaultThreadCount() {
+  uint32_t hardwareThreads = std::thread::hardware_concurrency();
+  return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
+
+void LveThreadPool::workerLoop() {
+  LVE_PROFILE_THREAD_NAME("worker");
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock{queueMutex};
+      condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+      // Drain the queue before exiting so no submitted future is left without a result
+      if (stopping && tasks.empty()) return;
+      task = std::move(tasks.front());
+      tasks.pop();
+    }
+    LVE_PROFILE_ZONE("task");
+    task();
+  }
+}
+
+}  // namespace lve
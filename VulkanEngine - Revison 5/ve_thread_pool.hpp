@@ -0,0 +1,54 @@
+#pragma once
+
+// std
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace lve {
+
+// Fixed set of worker threads pulling tasks from a single queue. submit() hands back a std::future
+// so callers can wait for (and receive exceptions from) the work they queued.
+class LveThreadPool {
+ public:
+  explicit LveThreadPool(uint32_t threadCount = defaultThreadCount());
+  ~LveThreadPool();
+
+  LveThreadPool(const LveThreadPool &) = delete;
+  LveThreadPool &operator=(const LveThreadPool &) = delete;
+
+  template <typename F>
+  auto submit(F &&task) -> std::future<decltype(task())> {
+    using Result = decltype(task());
+    auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+    std::future<Result> future = packagedTask->get_future();
+    {
+      std::lock_guard<std::mutex> lock{queueMutex};
+      tasks.emplace([packagedTask]() { (*packagedTask)(); });
+    }
+    condition.notify_one();
+    return future;
+  }
+
+  uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+  // One worker per hardware thread, leaving one for the thread that submits the work
+  static uint32_t defaultThreadCount();
+
+ private:
+  void workerLoop();
+
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()>> tasks;
+  std::mutex queueMutex;
+  std::condition_variable condition;
+  bool stopping = false;
+};
+
+}  // namespace lve
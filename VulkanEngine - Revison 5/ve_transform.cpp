@@ -2,15 +2,45 @@
 
 namespace lve {
 
-glm::mat4 TransformComponent::mat4() {
+const glm::mat4 &TransformComponent::mat4() {
+    if (isDirty()) {
+        updateCache();
+    }
+    return cachedMatrix;
+}
+
+const glm::mat3 &TransformComponent::normalMatrix() {
+    if (isDirty()) {
+        updateCache();
+    }
+    return cachedNormalMatrix;
+}
+
+bool TransformComponent::isDirty() const {
+    return !cacheValid || translation != cachedTranslation || rotation != cachedRotation ||
+           scale != cachedScale;
+}
+
+void TransformComponent::updateCache() {
+    version++;
+
+    // Only translation changed (the weapon while the view holds still): skip the trig. Projectiles
+    // keep their velocity in rotation, so they always take the full path below.
+    if (cacheValid && rotation == cachedRotation && scale == cachedScale) {
+        cachedMatrix[3] = glm::vec4{translation.x, translation.y, translation.z, 1.0f};
+        cachedTranslation = translation;
+        return;
+    }
+
     const float c3 = glm::cos(rotation.z);
     const float s3 = glm::sin(rotation.z);
     const float c2 = glm::cos(rotation.x);
     const float s2 = glm::sin(rotation.x);
     const float c1 = glm::cos(rotation.y);
     const float s1 = glm::sin(rotation.y);
-    
-    return glm::mat4{
+    const glm::vec3 invScale = 1.0f / scale;
+
+    cachedMatrix = glm::mat4{
         {
             scale.x * (c1 * c3 + s1 * s2 * s3),
             scale.x * (c2 * s3),
@@ -30,18 +60,8 @@ glm::mat4 TransformComponent::mat4() {
             0.0f,
         },
         {translation.x, translation.y, translation.z, 1.0f}};
-}
-
-glm::mat3 TransformComponent::normalMatrix() {
-    const float c3 = glm::cos(rotation.z);
-    const float s3 = glm::sin(rotation.z);
-    const float c2 = glm::cos(rotation.x);
-    const float s2 = glm::sin(rotation.x);
-    const float c1 = glm::cos(rotation.y);
-    const float s1 = glm::sin(rotation.y);
-    const glm::vec3 invScale = 1.0f / scale;
 
-    return glm::mat3{
+    cachedNormalMatrix = glm::mat3{
         {
             invScale.x * (c1 * c3 + s1 * s2 * s3),
             invScale.x * (c2 * s3),
@@ -57,6 +77,11 @@ glm::mat3 TransformComponent::normalMatrix() {
             invScale.z * (-s2),
             invScale.z * (c1 * c2),
         }};
+
+    cachedTranslation = translation;
+    cachedRotation = rotation;
+    cachedScale = scale;
+    cacheValid = true;
 }
 
 } // namespace lve
@@ -4,6 +4,9 @@
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+// std
+#include <cstdint>
+
 namespace lve {
 
 struct TransformComponent {
@@ -14,8 +17,29 @@ struct TransformComponent {
     // Matrix corresponds to Translate * Ry * Rx * Rz * Scale
     // Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
     // https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
-    glm::mat4 mat4();
-    glm::mat3 normalMatrix();
+    //
+    // Both matrices are cached and only rebuilt when translation, rotation or scale differ from the
+    // values they were built from, so an object that didn't move costs a compare and a load.
+    const glm::mat4 &mat4();
+    const glm::mat3 &normalMatrix();
+
+    bool isDirty() const;
+    void markDirty() { cacheValid = false; }
+
+    // Incremented whenever the cached matrices are rebuilt, so consumers that copied the matrix
+    // can tell whether their copy is stale
+    uint32_t getVersion() const { return version; }
+
+private:
+    void updateCache();
+
+    glm::vec3 cachedTranslation{};
+    glm::vec3 cachedScale{1.0f, 1.0f, 1.0f};
+    glm::vec3 cachedRotation{};
+    glm::mat4 cachedMatrix{1.0f};
+    glm::mat3 cachedNormalMatrix{1.0f};
+    bool cacheValid = false;
+    uint32_t version = 0;
 };
 
 } // namespace lve
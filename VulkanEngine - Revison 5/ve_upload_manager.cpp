@@ -0,0 +1,444 @@
+#include "ve_upload_manager.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace lve {
+
+LveUploadManager::LveUploadManager(LveDevice &device, VkDeviceSize ringSize)
+    : lveDevice{device}, ringSize{ringSize} {
+  if (lveDevice.supportsTimelineSemaphores()) {
+    timeline = std::make_unique<LveFrameTimeline>(lveDevice);
+  }
+
+  QueueFamilyIndices queueFamilyIndices = lveDevice.findPhysicalQueueFamilies();
+  dedicatedTransferQueue = lveDevice.hasDedicatedTransferQueue();
+  graphicsFamily = queueFamilyIndices.graphicsFamily;
+  transferFamily = dedicatedTransferQueue ? queueFamilyIndices.transferFamily : graphicsFamily;
+
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = transferFamily;
+  poolInfo.flags =
+      VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &copyCommandPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create upload command pool!");
+  }
+  if (dedicatedTransferQueue) {
+    poolInfo.queueFamilyIndex = graphicsFamily;
+    if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &acquireCommandPool) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create upload command pool!");
+    }
+  }
+
+  // Host-visible blocks stay mapped, and this memory type is coherent, so writes need no flush
+  lveDevice.createBuffer(
+      ringSize,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      ringBuffer,
+      ringAllocation);
+}
+
+LveUploadManager::~LveUploadManager() {
+  while (!inFlight.empty()) {
+    wait(inFlight.front().ticket);
+    retire();
+  }
+  for (auto &staging : pendingStagingBuffers) {
+    vkDestroyBuffer(lveDevice.device(), staging.buffer, nullptr);
+    lveDevice.memoryAllocator().free(staging.allocation);
+  }
+  for (VkFence fence : freeFences) {
+    vkDestroyFence(lveDevice.device(), fence, nullptr);
+  }
+  for (VkSemaphore semaphore : freeSemaphores) {
+    vkDestroySemaphore(lveDevice.device(), semaphore, nullptr);
+  }
+
+  vkDestroyBuffer(lveDevice.device(), ringBuffer, nullptr);
+  lveDevice.memoryAllocator().free(ringAllocation);
+  // Frees the command buffers with them
+  vkDestroyCommandPool(lveDevice.device(), copyCommandPool, nullptr);
+  if (acquireCommandPool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(lveDevice.device(), acquireCommandPool, nullptr);
+  }
+}
+
+LveUploadManager::Ticket LveUploadManager::upload(
+    VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size) {
+  if (size == 0) return submittedTicket;
+
+  PendingCopy copy{};
+  copy.dstBuffer = dstBuffer;
+  copy.region.dstOffset = dstOffset;
+  copy.region.size = size;
+
+  // A quarter of the ring at most, so one big upload cannot keep cycling the whole ring
+  if (size > ringSize / 4) {
+    StagingBuffer staging{};
+    lveDevice.createBuffer(
+        size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        staging.buffer,
+        staging.allocation);
+    std::memcpy(staging.allocation.mapped, data, static_cast<size_t>(size));
+    pendingStagingBuffers.push_back(staging);
+    copy.srcBuffer = staging.buffer;
+    copy.region.srcOffset = 0;
+  } else {
+    VkDeviceSize offset = allocateStaging(size);
+    char *destination = static_cast<char *>(ringAllocation.mapped) + offset;
+    std::memcpy(destination, data, static_cast<size_t>(size));
+    copy.srcBuffer = ringBuffer;
+    copy.region.srcOffset = offset;
+  }
+
+  pendingCopies.push_back(copy);
+  uploadedBytes += size;
+  return getPendingTicket();
+}
+
+LveUploadManager::Ticket LveUploadManager::flush() {
+  if (pendingCopies.empty()) return submittedTicket;
+  retire();
+
+  Batch batch{};
+  batch.ticket = submittedTicket + 1;
+  batch.copyCommandBuffer = beginCommandBuffer(copyCommandPool, freeCopyCommandBuffers);
+  recordCopies(batch.copyCommandBuffer);
+
+  if (!dedicatedTransferQueue) {
+    // Later submissions on the queue read the data as vertices, indices, uniforms or copy sources
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                            VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+                            VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        batch.copyCommandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+    if (vkEndCommandBuffer(batch.copyCommandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to record upload command buffer!");
+    }
+    submitGraphics(batch.copyCommandBuffer, VK_NULL_HANDLE, batch);
+  } else {
+    // Release on the transfer queue; the acquire below repeats the same barriers
+    std::vector<VkBufferMemoryBarrier> barriers = getOwnershipBarriers();
+    for (auto &barrier : barriers) {
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = 0;
+    }
+    vkCmdPipelineBarrier(
+        batch.copyCommandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        0,
+        nullptr,
+        static_cast<uint32_t>(barriers.size()),
+        barriers.data(),
+        0,
+        nullptr);
+    if (vkEndCommandBuffer(batch.copyCommandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to record upload command buffer!");
+    }
+
+    if (!freeSemaphores.empty()) {
+      batch.copySemaphore = freeSemaphores.back();
+      freeSemaphores.pop_back();
+    } else {
+      VkSemaphoreCreateInfo semaphoreInfo{};
+      semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      if (vkCreateSemaphore(lveDevice.device(), &semaphoreInfo, nullptr, &batch.copySemaphore) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload semaphore!");
+      }
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.copyCommandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &batch.copySemaphore;
+    if (vkQueueSubmit(lveDevice.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit upload command buffer!");
+    }
+
+    // The acquire makes the writes visible to everything submitted to the graphics queue after it
+    for (auto &barrier : barriers) {
+      barrier.srcAccessMask = 0;
+      barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                              VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+                              VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    }
+    batch.acquireCommandBuffer = beginCommandBuffer(acquireCommandPool, freeAcquireCommandBuffers);
+    vkCmdPipelineBarrier(
+        batch.acquireCommandBuffer,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0,
+        nullptr,
+        static_cast<uint32_t>(barriers.size()),
+        barriers.data(),
+        0,
+        nullptr);
+    if (vkEndCommandBuffer(batch.acquireCommandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to record upload acquire command buffer!");
+    }
+    submitGraphics(batch.acquireCommandBuffer, batch.copySemaphore, batch);
+  }
+
+  batch.ringEnd = ringHead;
+  batch.stagingBuffers = std::move(pendingStagingBuffers);
+  pendingStagingBuffers.clear();
+  pendingCopies.clear();
+  submittedTicket = batch.ticket;
+  inFlight.push_back(std::move(batch));
+  return submittedTicket;
+}
+
+bool LveUploadManager::isComplete(Ticket ticket) {
+  if (ticket <= completedTicket) return true;
+  retire();
+  return ticket <= completedTicket;
+}
+
+void LveUploadManager::wait(Ticket ticket) {
+  if (ticket > submittedTicket) flush();
+  if (isComplete(ticket)) return;
+
+  if (timeline != nullptr) {
+    timeline->wait(ticket);
+  } else {
+    for (const Batch &batch : inFlight) {
+      if (batch.ticket > ticket) break;
+      if (vkWaitForFences(lveDevice.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("failed to wait for upload fence!");
+      }
+    }
+  }
+  retire();
+}
+
+void LveUploadManager::waitIdle() { wait(flush()); }
+
+VkDeviceSize LveUploadManager::allocateStaging(VkDeviceSize size) {
+  size = (size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+  while (true) {
+    // An allocation never wraps; the tail of the ring is skipped instead
+    VkDeviceSize offset = ringHead % ringSize;
+    VkDeviceSize skip = offset + size > ringSize ? ringSize - offset : 0;
+    if (ringHead + skip + size - ringTail <= ringSize) {
+      ringHead += skip;
+      offset = ringHead % ringSize;
+      ringHead += size;
+      return offset;
+    }
+
+    // Out of room: free what the GPU has finished with, or else wait for the oldest batch
+    retire();
+    if (ringHead + skip + size - ringTail <= ringSize) continue;
+    if (inFlight.empty()) flush();
+    wait(inFlight.front().ticket);
+  }
+}
+
+void LveUploadManager::retire() {
+  while (!inFlight.empty() && isBatchComplete(inFlight.front())) {
+    Batch &batch = inFlight.front();
+    completedTicket = batch.ticket;
+    ringTail = batch.ringEnd;
+    releaseBatch(batch);
+    inFlight.pop_front();
+  }
+
+  // With the ring empty, start over at offset 0 rather than wherever the last copy ended
+  if (ringTail == ringHead) {
+    ringHead = ringTail = (ringHead + ringSize - 1) / ringSize * ringSize;
+  }
+}
+
+void LveUploadManager::releaseBatch(Batch &batch) {
+  for (auto &staging : batch.stagingBuffers) {
+    vkDestroyBuffer(lveDevice.device(), staging.buffer, nullptr);
+    lveDevice.memoryAllocator().free(staging.allocation);
+  }
+  freeCopyCommandBuffers.push_back(batch.copyCommandBuffer);
+  if (batch.acquireCommandBuffer != VK_NULL_HANDLE) {
+    freeAcquireCommandBuffers.push_back(batch.acquireCommandBuffer);
+    // The acquire waited on it, so it is unsignaled again
+    freeSemaphores.push_back(batch.copySemaphore);
+  }
+  if (batch.fence != VK_NULL_HANDLE) {
+    freeFences.push_back(batch.fence);
+  }
+}
+
+bool LveUploadManager::isBatchComplete(const Batch &batch) {
+  if (timeline != nullptr) return timeline->isComplete(batch.ticket);
+  return vkGetFenceStatus(lveDevice.device(), batch.fence) == VK_SUCCESS;
+}
+
+VkCommandBuffer LveUploadManager::beginCommandBuffer(
+    VkCommandPool pool, std::vector<VkCommandBuffer> &freeList) {
+  VkCommandBuffer commandBuffer;
+  if (!freeList.empty()) {
+    commandBuffer = freeList.back();
+    freeList.pop_back();
+    vkResetCommandBuffer(commandBuffer, 0);
+  } else {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = pool;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate upload command buffer!");
+    }
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin upload command buffer!");
+  }
+  return commandBuffer;
+}
+
+void LveUploadManager::submitGraphics(
+    VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, Batch &batch) {
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+
+  // The acquire barrier's source stage, so it chains onto the wait
+  VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  if (waitSemaphore != VK_NULL_HANDLE) {
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &waitSemaphore;
+    submitInfo.pWaitDstStageMask = &waitStage;
+  }
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+  VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+  uint64_t waitValue = 0;
+  uint64_t signalValue = 0;
+  if (timeline != nullptr) {
+    // Nothing else advances this timeline, so its values are the tickets
+    timelineSemaphore = timeline->getSemaphore();
+    signalValue = timeline->advance();
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    // Ignored for the binary wait semaphore, but the counts have to match
+    timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+    timelineInfo.pWaitSemaphoreValues = &waitValue;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &timelineSemaphore;
+  } else if (!freeFences.empty()) {
+    batch.fence = freeFences.back();
+    freeFences.pop_back();
+    vkResetFences(lveDevice.device(), 1, &batch.fence);
+  } else {
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(lveDevice.device(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create upload fence!");
+    }
+  }
+
+  if (vkQueueSubmit(lveDevice.graphicsQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit upload command buffer!");
+  }
+}
+
+void LveUploadManager::recordCopies(VkCommandBuffer commandBuffer) {
+  // One vkCmdCopyBuffer per source and destination pair
+  std::stable_sort(
+      pendingCopies.begin(),
+      pendingCopies.end(),
+      [](const PendingCopy &a, const PendingCopy &b) {
+        if (a.dstBuffer != b.dstBuffer) return a.dstBuffer < b.dstBuffer;
+        return a.srcBuffer < b.srcBuffer;
+      });
+
+  std::vector<VkBufferCopy> regions;
+  size_t first = 0;
+  while (first < pendingCopies.size()) {
+    regions.clear();
+    size_t last = first;
+    while (last < pendingCopies.size() &&
+           pendingCopies[last].dstBuffer == pendingCopies[first].dstBuffer &&
+           pendingCopies[last].srcBuffer == pendingCopies[first].srcBuffer) {
+      regions.push_back(pendingCopies[last++].region);
+    }
+    vkCmdCopyBuffer(
+        commandBuffer,
+        pendingCopies[first].srcBuffer,
+        pendingCopies[first].dstBuffer,
+        static_cast<uint32_t>(regions.size()),
+        regions.data());
+    first = last;
+  }
+}
+
+std::vector<VkBufferMemoryBarrier> LveUploadManager::getOwnershipBarriers() const {
+  std::vector<VkBufferCopy> regions;
+  std::vector<VkBufferMemoryBarrier> barriers;
+  // pendingCopies is sorted by destination by now
+  size_t first = 0;
+  while (first < pendingCopies.size()) {
+    VkBuffer dstBuffer = pendingCopies[first].dstBuffer;
+    regions.clear();
+    while (first < pendingCopies.size() && pendingCopies[first].dstBuffer == dstBuffer) {
+      regions.push_back(pendingCopies[first++].region);
+    }
+    std::sort(regions.begin(), regions.end(), [](const VkBufferCopy &a, const VkBufferCopy &b) {
+      return a.dstOffset < b.dstOffset;
+    });
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = transferFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+    barrier.buffer = dstBuffer;
+    barrier.offset = regions[0].dstOffset;
+    VkDeviceSize end = regions[0].dstOffset + regions[0].size;
+    for (size_t i = 1; i < regions.size(); i++) {
+      if (regions[i].dstOffset > end) {
+        barrier.size = end - barrier.offset;
+        barriers.push_back(barrier);
+        barrier.offset = regions[i].dstOffset;
+      }
+      end = std::max(end, regions[i].dstOffset + regions[i].size);
+    }
+    barrier.size = end - barrier.offset;
+    barriers.push_back(barrier);
+  }
+  return barriers;
+}
+
+}  // namespace lve
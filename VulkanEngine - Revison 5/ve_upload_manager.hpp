@@ -0,0 +1,133 @@
+#pragma once
+
+#include "ve_device.hpp"
+#include "ve_frame_timeline.hpp"
+
+// std
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// Streams data into device-local buffers without stalling. upload() copies the data into a
+// persistently mapped staging ring right away and queues the GPU copy; flush() records every
+// queued copy into one command buffer and submits it, followed by a barrier that makes the writes
+// visible to anything submitted later on the graphics queue. Frame submission (LveSwapChain,
+// LveOffscreenTarget) flushes, so uploads queued while building a frame land before it draws.
+//
+// With a dedicated transfer queue the copies run there, so streaming does not queue up behind
+// rendering. Destination buffers stay VK_SHARING_MODE_EXCLUSIVE: the copy command buffer releases
+// each written range to the graphics family, and a small graphics-queue command buffer, waiting
+// on the copies through a semaphore, acquires them. Ranges are written without being acquired by
+// the transfer family first, as their old contents are discarded anyway.
+//
+// Each flush is a batch with a ticket; batches signal a timeline semaphore where the device has
+// them and a fence otherwise, and their ring space is reused once they complete. Uploads too large
+// for the ring get a staging buffer of their own. Not thread-safe: use from the thread that submits
+// frames.
+class LveUploadManager {
+ public:
+  static constexpr VkDeviceSize DEFAULT_RING_SIZE = 32ull << 20;
+
+  // Identifies a batch; tickets increase with every flush. 0 counts as already complete.
+  using Ticket = uint64_t;
+
+  LveUploadManager(LveDevice &device, VkDeviceSize ringSize = DEFAULT_RING_SIZE);
+  // Waits for submitted batches; copies never flushed are dropped
+  ~LveUploadManager();
+
+  LveUploadManager(const LveUploadManager &) = delete;
+  LveUploadManager &operator=(const LveUploadManager &) = delete;
+
+  // dstBuffer needs VK_BUFFER_USAGE_TRANSFER_DST_BIT and must stay alive until the returned ticket
+  // completes. data may be freed as soon as this returns.
+  Ticket upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size);
+  // Submits everything queued since the last flush; returns the ticket of the newest batch
+  Ticket flush();
+
+  // Polls; never blocks
+  bool isComplete(Ticket ticket);
+  void wait(Ticket ticket);
+  // Flushes and waits for every batch
+  void waitIdle();
+
+  // Ticket the queued copies will get on the next flush
+  Ticket getPendingTicket() const { return submittedTicket + 1; }
+  uint64_t getBatchCount() const { return submittedTicket; }
+  VkDeviceSize getUploadedBytes() const { return uploadedBytes; }
+
+ private:
+  // Copy sources start on this boundary in the ring
+  static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+  struct PendingCopy {
+    VkBuffer srcBuffer;
+    VkBuffer dstBuffer;
+    VkBufferCopy region;
+  };
+
+  struct StagingBuffer {
+    VkBuffer buffer;
+    LveAllocation allocation;
+  };
+
+  struct Batch {
+    Ticket ticket = 0;
+    // On the transfer queue, which is the graphics queue when there is no dedicated one
+    VkCommandBuffer copyCommandBuffer = VK_NULL_HANDLE;
+    // Only with a dedicated transfer queue: the ownership acquire on the graphics queue, and the
+    // semaphore it waits on
+    VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+    VkSemaphore copySemaphore = VK_NULL_HANDLE;
+    // Only without timeline semaphores
+    VkFence fence = VK_NULL_HANDLE;
+    // Ring position after the batch's last copy; space up to here is free once it completes
+    uint64_t ringEnd = 0;
+    std::vector<StagingBuffer> stagingBuffers;
+  };
+
+  // Returns the ring offset of size free bytes, retiring (or waiting for) batches to make room
+  VkDeviceSize allocateStaging(VkDeviceSize size);
+  // Frees everything held by completed batches, oldest first
+  void retire();
+  void releaseBatch(Batch &batch);
+  bool isBatchComplete(const Batch &batch);
+  VkCommandBuffer beginCommandBuffer(VkCommandPool pool, std::vector<VkCommandBuffer> &freeList);
+  void recordCopies(VkCommandBuffer commandBuffer);
+  // One barrier per contiguous written range of each destination buffer
+  std::vector<VkBufferMemoryBarrier> getOwnershipBarriers() const;
+  // Submits commandBuffer to the graphics queue so that it completes batch
+  void submitGraphics(VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, Batch &batch);
+
+  LveDevice &lveDevice;
+  std::unique_ptr<LveFrameTimeline> timeline;
+  bool dedicatedTransferQueue;
+  uint32_t graphicsFamily;
+  uint32_t transferFamily;
+  VkCommandPool copyCommandPool = VK_NULL_HANDLE;
+  VkCommandPool acquireCommandPool = VK_NULL_HANDLE;
+
+  VkBuffer ringBuffer = VK_NULL_HANDLE;
+  LveAllocation ringAllocation{};
+  VkDeviceSize ringSize;
+  // Running byte counts; the ring offset is the position modulo ringSize. Bytes in
+  // [ringTail, ringHead) belong to queued copies or batches still in flight.
+  uint64_t ringHead = 0;
+  uint64_t ringTail = 0;
+
+  std::vector<PendingCopy> pendingCopies;
+  std::vector<StagingBuffer> pendingStagingBuffers;
+  std::deque<Batch> inFlight;
+  std::vector<VkCommandBuffer> freeCopyCommandBuffers;
+  std::vector<VkCommandBuffer> freeAcquireCommandBuffers;
+  std::vector<VkSemaphore> freeSemaphores;
+  std::vector<VkFence> freeFences;
+
+  Ticket submittedTicket = 0;
+  Ticket completedTicket = 0;
+  VkDeviceSize uploadedBytes = 0;
+};
+
+}  // namespace lve